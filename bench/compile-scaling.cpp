@@ -0,0 +1,94 @@
+#include <cstddef>
+#include <compare>
+#include <utility>
+
+/* Compile-time scaling benchmark: one variant with ALTERNATIVES alternatives goes through
+ * construction, get, visit of one to three variants, comparisons and swap.
+ * Defining BENCH_STD_VARIANT builds the same code against std::variant as a baseline.
+ * Multi-visit pairs the wide variant with narrow ones, so the number of visitor
+ * instantiations stays linear in ALTERNATIVES for both implementations */
+
+#ifndef ALTERNATIVES
+#define ALTERNATIVES 32
+#endif
+
+#ifdef BENCH_STD_VARIANT
+#include <variant>
+
+namespace bench {
+using std::variant;
+using std::get;
+using std::visit;
+using std::in_place_index;
+}
+#else
+#include "../variant.h"
+
+namespace bench {
+using ::variant;
+using ::get;
+using ::visit;
+using ::in_place_index;
+}
+#endif
+
+namespace bench {
+
+template <std::size_t Id>
+struct alternative_t {
+  std::size_t value = Id;
+
+  auto operator<=>(alternative_t const&) const = default;
+};
+
+struct sum_values {
+  template <typename... Alternatives>
+  std::size_t operator()(Alternatives const&... alternatives) const {
+    return (alternatives.value + ...);
+  }
+};
+
+template <typename Sequence>
+struct scaling;
+
+template <std::size_t... Ids>
+struct scaling<std::index_sequence<Ids...>> {
+  using wide_t = variant<alternative_t<Ids>...>;
+  using narrow_t = variant<alternative_t<0>, alternative_t<1>, alternative_t<2>, alternative_t<3>>;
+
+  static std::size_t construct() {
+    std::size_t sum = 0;
+    ((sum += wide_t(in_place_index<Ids>).index()), ...);
+    ((sum += wide_t(alternative_t<Ids>{}).index()), ...);
+    return sum;
+  }
+
+  static std::size_t access(wide_t const& v) {
+    std::size_t sum = 0;
+    ((sum += v.index() == Ids ? get<Ids>(v).value : 0), ...);
+    return sum;
+  }
+
+  static std::size_t visits(wide_t const& v, narrow_t const& n, narrow_t const& m) {
+    return visit(sum_values{}, v) + visit(sum_values{}, v, n) + visit(sum_values{}, v, n, m);
+  }
+
+  static std::size_t compare(wide_t const& v, wide_t const& w) {
+    return (v == w) + (v != w) + (v < w) + (v > w) + (v <= w) + (v >= w);
+  }
+
+  static void exchange(wide_t& v, wide_t& w) {
+    v.swap(w);
+    swap(v, w);
+  }
+};
+
+}
+
+using scaling_t = bench::scaling<std::make_index_sequence<ALTERNATIVES>>;
+
+std::size_t run_scaling(scaling_t::wide_t& v, scaling_t::wide_t& w, scaling_t::narrow_t const& n) {
+  std::size_t sum = scaling_t::construct() + scaling_t::access(v) + scaling_t::visits(v, n, n) + scaling_t::compare(v, w);
+  scaling_t::exchange(v, w);
+  return sum;
+}
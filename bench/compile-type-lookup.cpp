@@ -0,0 +1,37 @@
+#include <cstddef>
+#include <utility>
+
+#include "../variant.h"
+
+/* Compile-time benchmark of type lookups: every alternative of a wide variant
+ * is reached by type through get, get_if, holds_alternative, emplace and in_place_type */
+
+#ifndef ALTERNATIVES
+#define ALTERNATIVES 256
+#endif
+
+template <std::size_t Id>
+struct alternative_t {
+  std::size_t value = Id;
+};
+
+template <typename Sequence>
+struct lookups;
+
+template <std::size_t... Ids>
+struct lookups<std::index_sequence<Ids...>> {
+  using variant_t = variant<alternative_t<Ids>...>;
+
+  static std::size_t run(variant_t& v) {
+    std::size_t sum = 0;
+    ((sum += holds_alternative<alternative_t<Ids>>(v) ? get<alternative_t<Ids>>(v).value : 0), ...);
+    ((sum += get_if<alternative_t<Ids>>(&v) != nullptr ? 1 : 0), ...);
+    ((sum += variant_t(in_place_type<alternative_t<Ids>>).index()), ...);
+    ((sum += v.template emplace<alternative_t<Ids>>().value), ...);
+    return sum;
+  }
+};
+
+std::size_t run_lookups(lookups<std::make_index_sequence<ALTERNATIVES>>::variant_t& v) {
+  return lookups<std::make_index_sequence<ALTERNATIVES>>::run(v);
+}
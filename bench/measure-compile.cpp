@@ -0,0 +1,74 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Runs one compiler invocation and records its wall time, peak resident set size and
+ * the size of the produced object file.
+ * Usage: measure-compile <configuration> <results.csv> <object> <compiler> <arguments...>
+ * A line "configuration,wall seconds,peak rss KiB,object bytes" is appended to results.csv,
+ * the header is written when the file does not exist yet */
+
+int main(int argc, char** argv) {
+  if (argc < 5) {
+    std::cerr << "usage: " << argv[0] << " <configuration> <results.csv> <object> <compiler> <arguments...>\n";
+    return 2;
+  }
+  std::string configuration = argv[1];
+  std::string results = argv[2];
+  std::string object = argv[3];
+
+  auto start = std::chrono::steady_clock::now();
+  pid_t pid = fork();
+  if (pid < 0) {
+    std::perror("fork");
+    return 1;
+  }
+  if (pid == 0) {
+    execvp(argv[4], argv + 4);
+    std::perror("execvp");
+    _exit(127);
+  }
+
+  int status = 0;
+  rusage usage{};
+  if (wait4(pid, &status, 0, &usage) < 0) {
+    std::perror("wait4");
+    return 1;
+  }
+  std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    std::cerr << configuration << ": compiler failed\n";
+    return 1;
+  }
+
+  struct stat object_stat {};
+  if (stat(object.c_str(), &object_stat) != 0) {
+    std::perror(object.c_str());
+    return 1;
+  }
+
+  // ru_maxrss is in KiB on Linux and in bytes on macOS
+#ifdef __APPLE__
+  long peak_rss = usage.ru_maxrss / 1024;
+#else
+  long peak_rss = usage.ru_maxrss;
+#endif
+
+  std::printf("%-24s wall %8.3f s   peak rss %8ld KiB   object %10lld bytes\n", configuration.c_str(), wall.count(),
+              peak_rss, static_cast<long long>(object_stat.st_size));
+
+  bool new_results = !std::ifstream(results).good();
+  std::ofstream out(results, std::ios::app);
+  if (new_results) {
+    out << "configuration,wall seconds,peak rss KiB,object bytes\n";
+  }
+  out << configuration << ',' << wall.count() << ',' << peak_rss << ',' << object_stat.st_size << '\n';
+  return out ? 0 : 1;
+}
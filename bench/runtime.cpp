@@ -0,0 +1,679 @@
+#include <chrono>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "../variant.h"
+#include "../variant-batch.h"
+#include "../variant-packed-sequence.h"
+#include "../variant-serialize.h"
+#include "../variant-vector.h"
+
+/* Runtime benchmark: every case runs over arrays of variants once against this variant and
+ * once against std::variant with the same alternatives, and both results are printed side by side.
+ * Usage: bench [--min-time <seconds>] [filter...], a case runs if its name contains any filter */
+
+namespace bench {
+
+#if defined(__GNUC__) || defined(__clang__)
+template <typename T>
+inline void keep(T const& value) {
+  asm volatile("" : : "g"(std::addressof(value)) : "memory");
+}
+#else
+inline void const volatile* volatile sink;
+
+template <typename T>
+inline void keep(T const& value) {
+  sink = std::addressof(value);
+}
+#endif
+
+struct point {
+  int x;
+  int y;
+
+  auto operator<=>(point const&) const = default;
+};
+
+inline std::size_t weight(int x) {
+  return static_cast<std::size_t>(x);
+}
+
+inline std::size_t weight(double x) {
+  return static_cast<std::size_t>(x);
+}
+
+inline std::size_t weight(point const& p) {
+  return static_cast<std::size_t>(p.x + p.y);
+}
+
+/* Trivially destructible alternatives of the wide variant */
+template <std::size_t Id>
+struct tag {
+  int value;
+
+  auto operator<=>(tag const&) const = default;
+};
+
+template <std::size_t Id>
+std::size_t weight(tag<Id> const& t) {
+  return static_cast<std::size_t>(t.value);
+}
+
+inline std::size_t weight(std::string const& s) {
+  return s.size();
+}
+
+inline std::size_t weight(std::vector<int> const& v) {
+  return v.size();
+}
+
+/* Element count of every array, small enough to stay in L1 for the trivial alternatives */
+inline constexpr std::size_t elements = 1024;
+
+/* Arrays of variants shared by all cases: a and b hold the same alternatives, c holds the next one
+ * at every position, d equals a except every third position. firsts holds only the first alternative */
+template <template <typename...> typename Variant, typename... Types>
+struct fixture {
+  using variant_t = Variant<Types...>;
+  constexpr static std::size_t alternatives = sizeof...(Types);
+
+  explicit fixture(Types... samples)
+      : samples(std::move(samples)...) {
+    std::size_t seed = 12345;
+    for (std::size_t i = 0; i < elements; ++i) {
+      seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+      std::size_t id = (seed >> 33) % alternatives;
+      a.push_back(make(id));
+      b.push_back(make(id));
+      c.push_back(make((id + 1) % alternatives));
+      d.push_back(make(i % 3 == 0 ? (id + 1) % alternatives : id));
+      firsts.push_back(make(0));
+    }
+  }
+
+  variant_t make(std::size_t id) const {
+    return make(id, std::index_sequence_for<Types...>());
+  }
+
+  template <std::size_t... Ids>
+  variant_t make(std::size_t id, std::index_sequence<Ids...>) const {
+    variant_t result;
+    ((id == Ids ? void(result.template emplace<Ids>(std::get<Ids>(samples))) : void()), ...);
+    return result;
+  }
+
+  std::tuple<Types...> samples;
+  std::vector<variant_t> a;
+  std::vector<variant_t> b;
+  std::vector<variant_t> c;
+  std::vector<variant_t> d;
+  std::vector<variant_t> firsts;
+};
+
+struct measurement {
+  double ns_per_op;
+  double ops_per_s;
+};
+
+/* Repeats one pass of the case until min_time has elapsed, a pass returns the number of operations done */
+template <typename Fixture, typename Case>
+measurement measure(Fixture& f, Case& run, double min_time) {
+  run(f);
+  std::size_t ops = 0;
+  auto start = std::chrono::steady_clock::now();
+  std::chrono::duration<double> elapsed{};
+  do {
+    ops += run(f);
+    elapsed = std::chrono::steady_clock::now() - start;
+  } while (elapsed.count() < min_time);
+  double ns_per_op = elapsed.count() * 1e9 / static_cast<double>(ops);
+  return {ns_per_op, 1e9 / ns_per_op};
+}
+
+struct options {
+  double min_time = 0.05;
+  std::vector<std::string> filters;
+
+  bool selected(std::string const& name) const {
+    if (filters.empty()) {
+      return true;
+    }
+    for (std::string const& filter : filters) {
+      if (name.find(filter) != std::string::npos) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+template <typename Ours, typename Std, typename Case>
+void compare(options const& opts, char const* group, char const* name, Ours& ours, Std& theirs, Case run) {
+  std::string full_name = std::string(group) + "/" + name;
+  if (!opts.selected(full_name)) {
+    return;
+  }
+  measurement o = measure(ours, run, opts.min_time);
+  measurement s = measure(theirs, run, opts.min_time);
+  std::printf("%-40s %10.2f %10.2f %12.0f %12.0f %8.2f\n", full_name.c_str(), o.ns_per_op, s.ns_per_op,
+              o.ops_per_s, s.ops_per_s, s.ns_per_op / o.ns_per_op);
+}
+
+template <typename... Types, typename F>
+void visit_range(std::vector<::variant<Types...>> const& items, F&& f) {
+  visit_batched(items, f);
+}
+
+template <typename... Types, typename F>
+void visit_range(std::vector<std::variant<Types...>> const& items, F&& f) {
+  for (auto const& v : items) {
+    std::visit(f, v);
+  }
+}
+
+/* Every case is generic over the fixture and is called unqualified,
+ * so the same code picks this variant's or std functions by argument dependent lookup */
+template <typename Ours, typename Std>
+void run_group(options const& opts, char const* group, Ours& ours, Std& theirs) {
+  auto visitor = [](auto const& x) { return weight(x); };
+  auto pair_visitor = [](auto const& x, auto const& y) { return weight(x) + weight(y); };
+
+  compare(opts, group, "default_ctor", ours, theirs, []<typename F>(F&) {
+    for (std::size_t i = 0; i < elements; ++i) {
+      typename F::variant_t v;
+      keep(v);
+    }
+    return elements;
+  });
+
+  compare(opts, group, "converting_ctor", ours, theirs, []<typename F>(F& f) {
+    for (std::size_t i = 0; i < elements; ++i) {
+      typename F::variant_t v(std::get<1>(f.samples));
+      keep(v);
+    }
+    return elements;
+  });
+
+  compare(opts, group, "converting_assign", ours, theirs, []<typename F>(F& f) {
+    for (auto& v : f.a) {
+      v = std::get<1>(f.samples);
+      keep(v);
+      v = std::get<0>(f.samples);
+      keep(v);
+    }
+    return 2 * elements;
+  });
+
+  compare(opts, group, "emplace", ours, theirs, []<typename F>(F& f) {
+    for (auto& v : f.a) {
+      v.template emplace<1>(std::get<1>(f.samples));
+      keep(v);
+      v.template emplace<0>(std::get<0>(f.samples));
+      keep(v);
+    }
+    return 2 * elements;
+  });
+
+  compare(opts, group, "copy_assign_same", ours, theirs, []<typename F>(F& f) {
+    for (std::size_t i = 0; i < elements; ++i) {
+      f.a[i] = f.b[i];
+      keep(f.a[i]);
+    }
+    return elements;
+  });
+
+  /* Sources alternate between b and c, so every assignment changes the alternative */
+  compare(opts, group, "copy_assign_cross", ours, theirs, []<typename F>(F& f) {
+    for (std::size_t i = 0; i < elements; ++i) {
+      f.a[i] = f.c[i];
+      keep(f.a[i]);
+      f.a[i] = f.b[i];
+      keep(f.a[i]);
+    }
+    return 2 * elements;
+  });
+
+  compare(opts, group, "move_assign_same", ours, theirs, []<typename F>(F& f) {
+    for (std::size_t i = 0; i < elements; ++i) {
+      f.a[i] = std::move(f.b[i]);
+      keep(f.a[i]);
+      f.b[i] = std::move(f.a[i]);
+      keep(f.b[i]);
+    }
+    return 2 * elements;
+  });
+
+  /* Values rotate through a, c and b. a and b keep holding the same alternative and c the other one,
+   * so every assignment changes the alternative. Moved-from values are recycled, only dispatch is measured */
+  compare(opts, group, "move_assign_cross", ours, theirs, []<typename F>(F& f) {
+    for (std::size_t i = 0; i < elements; ++i) {
+      f.a[i] = std::move(f.c[i]);
+      keep(f.a[i]);
+      f.c[i] = std::move(f.b[i]);
+      keep(f.c[i]);
+      f.b[i] = std::move(f.a[i]);
+      keep(f.b[i]);
+    }
+    return 3 * elements;
+  });
+
+  compare(opts, group, "swap_same", ours, theirs, []<typename F>(F& f) {
+    for (std::size_t i = 0; i < elements; ++i) {
+      swap(f.a[i], f.b[i]);
+      keep(f.a[i]);
+    }
+    return elements;
+  });
+
+  compare(opts, group, "swap_cross", ours, theirs, []<typename F>(F& f) {
+    for (std::size_t i = 0; i < elements; ++i) {
+      swap(f.a[i], f.c[i]);
+      keep(f.a[i]);
+    }
+    return elements;
+  });
+
+  compare(opts, group, "visit", ours, theirs, [visitor]<typename F>(F& f) {
+    std::size_t sum = 0;
+    for (auto const& v : f.a) {
+      sum += visit(visitor, v);
+    }
+    keep(sum);
+    return elements;
+  });
+
+  /* std::variant has no batched visit, it is visited element by element */
+  compare(opts, group, "visit_batched", ours, theirs, []<typename F>(F& f) {
+    std::size_t sum = 0;
+    visit_range(f.a, [&](auto const& x) { sum += weight(x); });
+    keep(sum);
+    return elements;
+  });
+
+  compare(opts, group, "visit_two", ours, theirs, [pair_visitor]<typename F>(F& f) {
+    std::size_t sum = 0;
+    for (std::size_t i = 0; i < elements; ++i) {
+      sum += visit(pair_visitor, f.a[i], f.c[i]);
+    }
+    keep(sum);
+    return elements;
+  });
+
+  compare(opts, group, "get_index", ours, theirs, []<typename F>(F& f) {
+    std::size_t sum = 0;
+    for (auto const& v : f.firsts) {
+      sum += weight(get<0>(v));
+    }
+    keep(sum);
+    return elements;
+  });
+
+  compare(opts, group, "get_type", ours, theirs, []<typename F>(F& f) {
+    std::size_t sum = 0;
+    for (auto const& v : f.firsts) {
+      sum += weight(get<std::remove_cvref_t<decltype(get<0>(v))>>(v));
+    }
+    keep(sum);
+    return elements;
+  });
+
+  compare(opts, group, "get_if", ours, theirs, []<typename F>(F& f) {
+    std::size_t sum = 0;
+    for (auto const& v : f.a) {
+      if (auto const* p = get_if<1>(&v)) {
+        sum += weight(*p);
+      }
+    }
+    keep(sum);
+    return elements;
+  });
+
+  compare(opts, group, "equal", ours, theirs, []<typename F>(F& f) {
+    std::size_t sum = 0;
+    for (std::size_t i = 0; i < elements; ++i) {
+      sum += f.a[i] == f.d[i];
+    }
+    keep(sum);
+    return elements;
+  });
+
+  compare(opts, group, "not_equal", ours, theirs, []<typename F>(F& f) {
+    std::size_t sum = 0;
+    for (std::size_t i = 0; i < elements; ++i) {
+      sum += f.a[i] != f.d[i];
+    }
+    keep(sum);
+    return elements;
+  });
+
+  compare(opts, group, "less", ours, theirs, []<typename F>(F& f) {
+    std::size_t sum = 0;
+    for (std::size_t i = 0; i < elements; ++i) {
+      sum += f.a[i] < f.d[i];
+    }
+    keep(sum);
+    return elements;
+  });
+
+  compare(opts, group, "greater", ours, theirs, []<typename F>(F& f) {
+    std::size_t sum = 0;
+    for (std::size_t i = 0; i < elements; ++i) {
+      sum += f.a[i] > f.d[i];
+    }
+    keep(sum);
+    return elements;
+  });
+
+  compare(opts, group, "less_equal", ours, theirs, []<typename F>(F& f) {
+    std::size_t sum = 0;
+    for (std::size_t i = 0; i < elements; ++i) {
+      sum += f.a[i] <= f.d[i];
+    }
+    keep(sum);
+    return elements;
+  });
+
+  compare(opts, group, "greater_equal", ours, theirs, []<typename F>(F& f) {
+    std::size_t sum = 0;
+    for (std::size_t i = 0; i < elements; ++i) {
+      sum += f.a[i] >= f.d[i];
+    }
+    keep(sum);
+    return elements;
+  });
+
+  if constexpr (std::is_default_constructible_v<std::hash<typename Ours::variant_t>>) {
+    compare(opts, group, "hash", ours, theirs, []<typename F>(F& f) {
+      std::hash<typename F::variant_t> hash;
+      std::size_t sum = 0;
+      for (auto const& v : f.a) {
+        sum += hash(v);
+      }
+      keep(sum);
+      return elements;
+    });
+  }
+}
+
+template <typename... Types>
+void run_alternatives(options const& opts, char const* group, Types const&... samples) {
+  fixture<::variant, Types...> ours(samples...);
+  fixture<std::variant, Types...> theirs(samples...);
+  run_group(opts, group, ours, theirs);
+}
+
+/* Sequences of mixed alternatives, big enough to leave L1: variant_vector keeps tags apart from payloads,
+ * std::vector of std::variant interleaves them */
+inline constexpr std::size_t sequence_elements = 1 << 16;
+
+template <typename Container>
+struct sequence_fixture {
+  Container items;
+};
+
+template <typename... Types, typename F>
+void for_each_element(variant_vector<Types...> const& items, F&& f) {
+  items.visit_each(f);
+}
+
+template <typename... Types, typename F>
+void for_each_element(packed_variant_sequence<Types...> const& items, F&& f) {
+  items.visit_each(f);
+}
+
+template <typename... Types, typename F>
+void for_each_element(std::vector<std::variant<Types...>> const& items, F&& f) {
+  for (auto const& v : items) {
+    std::visit(f, v);
+  }
+}
+
+template <typename... Types>
+std::size_t encode(::variant<Types...> const& v, std::span<std::byte> out) {
+  return serialize(v, out);
+}
+
+template <typename... Types>
+std::size_t decode(std::span<std::byte const> in, ::variant<Types...>& v) {
+  return deserialize(in, v);
+}
+
+/* Encoding as it is written by hand for std::variant: index byte and the payload written by a visitor,
+ * decoded into a temporary that is moved into the variant */
+template <typename... Types>
+std::size_t encode(std::variant<Types...> const& v, std::span<std::byte> out) {
+  out[0] = static_cast<std::byte>(v.index());
+  return 1 + std::visit([&]<typename T>(T const& value) -> std::size_t {
+    if constexpr (std::is_same_v<T, std::string>) {
+      std::uint64_t length = value.size();
+      std::memcpy(out.data() + 1, &length, sizeof(length));
+      std::memcpy(out.data() + 1 + sizeof(length), value.data(), value.size());
+      return sizeof(length) + value.size();
+    } else {
+      std::memcpy(out.data() + 1, &value, sizeof(T));
+      return sizeof(T);
+    }
+  }, v);
+}
+
+template <std::size_t Id, typename... Types>
+std::size_t decode_alternative(std::span<std::byte const> in, std::variant<Types...>& v) {
+  using T = std::variant_alternative_t<Id, std::variant<Types...>>;
+  if constexpr (std::is_same_v<T, std::string>) {
+    std::uint64_t length;
+    std::memcpy(&length, in.data(), sizeof(length));
+    v.template emplace<Id>(std::string(reinterpret_cast<char const*>(in.data() + sizeof(length)), length));
+    return sizeof(length) + length;
+  } else {
+    T value;
+    std::memcpy(&value, in.data(), sizeof(T));
+    v.template emplace<Id>(value);
+    return sizeof(T);
+  }
+}
+
+template <typename... Types>
+std::size_t decode(std::span<std::byte const> in, std::variant<Types...>& v) {
+  std::size_t index = static_cast<std::size_t>(in[0]);
+  std::size_t consumed = 0;
+  [&]<std::size_t... Ids>(std::index_sequence<Ids...>) {
+    ((index == Ids ? (consumed = decode_alternative<Ids>(in.subspan(1), v), 0) : 0), ...);
+  }(std::index_sequence_for<Types...>());
+  return 1 + consumed;
+}
+
+template <typename... Types>
+void run_sequences(options const& opts, char const* group, Types const&... samples) {
+  sequence_fixture<variant_vector<Types...>> ours;
+  sequence_fixture<std::vector<::variant<Types...>>> ours_plain;
+  sequence_fixture<packed_variant_sequence<Types...>> ours_packed;
+  sequence_fixture<std::vector<std::variant<Types...>>> theirs;
+  std::size_t seed = 12345;
+  for (std::size_t i = 0; i < sequence_elements; ++i) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    std::size_t id = (seed >> 33) % sizeof...(Types);
+    std::size_t current = 0;
+    ((id == current++ ? (ours.items.push_back(samples), ours_plain.items.push_back(samples),
+                         ours_packed.items.push_back(samples), theirs.items.push_back(samples))
+                      : void()),
+     ...);
+  }
+
+  compare(opts, group, "count_index", ours, theirs, []<typename F>(F& f) {
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < f.items.size(); ++i) {
+      count += f.items[i].index() == 0;
+    }
+    keep(count);
+    return f.items.size();
+  });
+
+  compare(opts, group, "visit_each", ours, theirs, []<typename F>(F& f) {
+    std::size_t sum = 0;
+    for_each_element(f.items, [&](auto const& x) { sum += weight(x); });
+    keep(sum);
+    return f.items.size();
+  });
+
+  compare(opts, group, "packed_visit_each", ours_packed, theirs, []<typename F>(F& f) {
+    std::size_t sum = 0;
+    for_each_element(f.items, [&](auto const& x) { sum += weight(x); });
+    keep(sum);
+    return f.items.size();
+  });
+
+  compare(opts, group, "serialize_round_trip", ours_plain, theirs, []<typename F>(F& f) {
+    static std::vector<std::byte> buffer(sequence_elements * 64);
+    std::size_t used = 0;
+    for (auto const& v : f.items) {
+      used += encode(v, std::span(buffer).subspan(used));
+    }
+    std::span<std::byte const> in(buffer.data(), used);
+    typename decltype(f.items)::value_type v;
+    std::size_t sum = 0;
+    while (!in.empty()) {
+      in = in.subspan(decode(in, v));
+      sum += v.index();
+    }
+    keep(sum);
+    return f.items.size();
+  });
+
+  /* Too long for the branch predictor to learn the order of alternatives */
+  compare(opts, group, "visit_batched", ours_plain, theirs, []<typename F>(F& f) {
+    std::size_t sum = 0;
+    visit_range(f.items, [&](auto const& x) { sum += weight(x); });
+    keep(sum);
+    return f.items.size();
+  });
+}
+
+/* Balanced binary trees built, walked and torn down in every pass: recursive_wrapper with std::allocator
+ * or with a monotonic arena against std::variant with a hand-rolled std::unique_ptr indirection */
+inline constexpr int tree_depth = 16;
+
+template <typename Tree>
+struct tree_node {
+  Tree left;
+  Tree right;
+};
+
+struct std_tree : std::variant<int, std::unique_ptr<tree_node<std_tree>>> {
+  using variant::variant;
+};
+
+template <bool Arena>
+struct wrapped_tree;
+
+template <bool Arena>
+using tree_allocator = std::conditional_t<Arena, std::pmr::polymorphic_allocator<tree_node<wrapped_tree<Arena>>>,
+                                          std::allocator<tree_node<wrapped_tree<Arena>>>>;
+
+template <bool Arena>
+struct wrapped_tree : ::variant<int, recursive_wrapper<tree_node<wrapped_tree<Arena>>, tree_allocator<Arena>>> {
+  using ::variant<int, recursive_wrapper<tree_node<wrapped_tree<Arena>>, tree_allocator<Arena>>>::variant;
+};
+
+struct std_tree_fixture {
+  static std_tree build(int depth) {
+    if (depth == 0) {
+      return std_tree(1);
+    }
+    return std_tree(std::make_unique<tree_node<std_tree>>(build(depth - 1), build(depth - 1)));
+  }
+
+  static std::size_t leaves(std_tree const& tree) {
+    if (auto node = std::get_if<1>(&tree)) {
+      return leaves((*node)->left) + leaves((*node)->right);
+    }
+    return 1;
+  }
+
+  std::size_t run() {
+    std_tree tree = build(tree_depth);
+    return leaves(tree);
+  }
+};
+
+template <bool Arena>
+struct wrapped_tree_fixture {
+  using tree_t = wrapped_tree<Arena>;
+  using node_t = tree_node<tree_t>;
+  using wrapper_t = recursive_wrapper<node_t, tree_allocator<Arena>>;
+
+  static tree_t build(int depth, tree_allocator<Arena> const& alloc) {
+    if (depth == 0) {
+      return tree_t(1);
+    }
+    return tree_t(wrapper_t(std::allocator_arg, alloc, build(depth - 1, alloc), build(depth - 1, alloc)));
+  }
+
+  static std::size_t leaves(tree_t const& tree) {
+    if (auto node = get_if<1>(&tree)) {
+      return leaves(node->left) + leaves(node->right);
+    }
+    return 1;
+  }
+
+  std::size_t run() {
+    if constexpr (Arena) {
+      std::pmr::monotonic_buffer_resource arena((std::size_t(1) << tree_depth) * sizeof(node_t));
+      tree_t tree = build(tree_depth, &arena);
+      return leaves(tree);
+    } else {
+      tree_t tree = build(tree_depth, {});
+      return leaves(tree);
+    }
+  }
+};
+
+void run_trees(options const& opts, char const* group) {
+  wrapped_tree_fixture<false> ours;
+  wrapped_tree_fixture<true> ours_arena;
+  std_tree_fixture theirs;
+  compare(opts, group, "build_walk_destroy", ours, theirs, [](auto& f) { return f.run(); });
+  compare(opts, group, "arena_build_walk_destroy", ours_arena, theirs, [](auto& f) { return f.run(); });
+}
+
+/* Wide enough for table dispatch, alternative 1 is a std::string and the others are trivial */
+template <std::size_t... Ids>
+void run_wide_mixed(options const& opts, char const* group, std::index_sequence<0, 1, Ids...>) {
+  run_alternatives(opts, group, tag<0>{7}, std::string("short"), tag<Ids>{static_cast<int>(Ids)}...);
+}
+
+}
+
+int main(int argc, char** argv) {
+  bench::options opts;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+      opts.min_time = std::atof(argv[++i]);
+    } else {
+      opts.filters.emplace_back(argv[i]);
+    }
+  }
+
+  std::printf("%-40s %10s %10s %12s %12s %8s\n", "case", "ns/op", "std ns/op", "ops/s", "std ops/s", "speedup");
+  bench::run_alternatives(opts, "trivial", 7, 2.5, bench::point{3, 4});
+  bench::run_alternatives(opts, "non_trivial", 7, std::string("short"), std::vector<int>{1, 2, 3});
+  bench::run_alternatives(opts, "mixed", 7, 2.5, std::string("short"));
+  bench::run_wide_mixed(opts, "mixed_wide", std::make_index_sequence<40>());
+  bench::run_sequences(opts, "sequence", 7, 2.5, std::string("short"));
+  bench::run_trees(opts, "tree");
+  return 0;
+}
@@ -0,0 +1,185 @@
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <string>
+#include <vector>
+
+/* Checks code generated for codegen/samples.cpp: disassembles the object with objdump
+ * and compares every canonical function against its limits on calls, instructions and stack.
+ * Usage: codegen-check <objdump> <samples object>
+ * Exits with 1 if any limit is exceeded, with 77 (skipped) if the object is not x86-64 */
+
+namespace {
+
+struct limits {
+  char const* name;
+  std::size_t max_instructions;
+  std::size_t max_calls;
+  std::size_t max_stack;
+};
+
+/* Calls on the path that throws bad_variant_access are not counted, they are cold by construction */
+constexpr limits expected[] = {
+    {"codegen_visit_small", 32, 0, 0},
+    {"codegen_get_index", 8, 0, 0},
+    {"codegen_get_unchecked", 2, 0, 0},
+    {"codegen_copy_trivial", 8, 0, 0},
+    {"codegen_equal", 32, 0, 0},
+    {"codegen_less", 48, 0, 0},
+};
+
+struct function {
+  std::vector<std::string> lines;
+  std::size_t instructions = 0;
+  std::size_t calls = 0;
+  std::size_t stack = 0;
+};
+
+bool is_throw_path(std::string const& target) {
+  for (char const* prefix : {"__cxa_", "_Unwind_Resume", "std::runtime_error::runtime_error", "std::terminate"}) {
+    if (target.rfind(prefix, 0) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool is_padding(std::string const& mnemonic, std::string const& operands) {
+  return mnemonic.rfind("nop", 0) == 0 || mnemonic == "cs" || mnemonic == "data16" ||
+         (mnemonic == "xchg" && operands == "%ax,%ax");
+}
+
+/* Whether a direct call or jump leaves the function through a counted call: target is taken from
+ * the relocation when there is one, otherwise from the symbol objdump prints next to the address */
+bool counts_as_call(std::string const& mnemonic, std::string const& target, std::string const& self) {
+  if (mnemonic == "call") {
+    return !is_throw_path(target);
+  }
+  return target.front() != '.' && target != self;
+}
+
+/* Parses "objdump -d -r -C --no-show-raw-insn" output */
+std::map<std::string, function> disassemble(std::string const& objdump, std::string const& object, bool& x86_64) {
+  std::string command = objdump + " -d -r -C --no-show-raw-insn '" + object + "'";
+  FILE* pipe = popen(command.c_str(), "r");
+  if (pipe == nullptr) {
+    std::perror("popen");
+    return {};
+  }
+
+  std::regex const header(R"(^[0-9a-f]+ <(.+)>:$)");
+  std::regex const instruction(R"(^\s+[0-9a-f]+:\t(\S+)\s*(.*)$)");
+  std::regex const relocation(R"(^\s+[0-9a-f]+: R_\S+\t([^+-]+).*$)");
+  std::regex const symbol(R"(^[0-9a-f]+ <(.+?)(\+0x[0-9a-f]+)?>$)");
+  std::regex const stack_adjust(R"(^sub \$0x([0-9a-f]+),%rsp$)");
+
+  std::map<std::string, function> functions;
+  std::string name;
+  function* current = nullptr;
+  std::string pending;
+  std::string pending_target;
+  auto resolve_pending = [&](std::string const& target) {
+    if (!pending.empty() && !target.empty() && counts_as_call(pending, target, name)) {
+      ++current->calls;
+    }
+    pending.clear();
+  };
+
+  char buffer[4096];
+  while (std::fgets(buffer, sizeof(buffer), pipe) != nullptr) {
+    std::string line(buffer);
+    if (!line.empty() && line.back() == '\n') {
+      line.pop_back();
+    }
+    if (line.find("file format elf64-x86-64") != std::string::npos) {
+      x86_64 = true;
+    }
+
+    std::smatch match;
+    if (std::regex_match(line, match, header)) {
+      if (current != nullptr) {
+        resolve_pending(pending_target);
+      }
+      name = match[1];
+      current = &functions[name];
+      continue;
+    }
+    if (current == nullptr) {
+      continue;
+    }
+    if (std::regex_match(line, match, relocation)) {
+      current->lines.push_back(line);
+      resolve_pending(match[1]);
+      continue;
+    }
+    if (!std::regex_match(line, match, instruction)) {
+      continue;
+    }
+    current->lines.push_back(line);
+    resolve_pending(pending_target);
+    std::string mnemonic = match[1];
+    std::string operands = match[2];
+    if (is_padding(mnemonic, operands)) {
+      continue;
+    }
+    ++current->instructions;
+
+    if (mnemonic == "call" || mnemonic == "jmp") {
+      if (!operands.empty() && operands.front() == '*') {
+        current->calls += (mnemonic == "call");
+      } else {
+        pending = mnemonic;
+        pending_target = std::regex_match(operands, match, symbol) ? match[1].str() : std::string();
+      }
+    } else if (mnemonic == "push") {
+      current->stack += 8;
+    } else if (std::string compact = mnemonic + " " + operands; std::regex_match(compact, match, stack_adjust)) {
+      current->stack += std::stoul(match[1], nullptr, 16);
+    }
+  }
+  if (current != nullptr) {
+    resolve_pending(pending_target);
+  }
+  pclose(pipe);
+  return functions;
+}
+
+}
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    std::cerr << "usage: " << argv[0] << " <objdump> <samples object>\n";
+    return 2;
+  }
+
+  bool x86_64 = false;
+  std::map<std::string, function> functions = disassemble(argv[1], argv[2], x86_64);
+  if (!x86_64) {
+    std::cout << "codegen limits are defined for x86-64 only, skipped\n";
+    return 77;
+  }
+
+  bool failed = false;
+  std::printf("%-24s %14s %8s %10s\n", "function", "instructions", "calls", "stack");
+  for (limits const& limit : expected) {
+    auto it = functions.find(limit.name);
+    if (it == functions.end()) {
+      std::printf("%-24s not found in the object\n", limit.name);
+      failed = true;
+      continue;
+    }
+    function const& f = it->second;
+    std::printf("%-24s %6zu / %-6zu %3zu / %-3zu %4zu / %-4zu\n", limit.name, f.instructions,
+                limit.max_instructions, f.calls, limit.max_calls, f.stack, limit.max_stack);
+    if (f.instructions > limit.max_instructions || f.calls > limit.max_calls || f.stack > limit.max_stack) {
+      std::printf("\n!!! CODEGEN REGRESSION in %s, generated code:\n", limit.name);
+      for (std::string const& line : f.lines) {
+        std::printf("%s\n", line.c_str());
+      }
+      std::printf("\n");
+      failed = true;
+    }
+  }
+  return failed ? 1 : 0;
+}
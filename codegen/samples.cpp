@@ -0,0 +1,45 @@
+#include "../variant.h"
+
+/* Canonical functions whose generated code is checked by codegen/check.cpp.
+ * They have C linkage, so the checker finds them by their plain names */
+
+namespace codegen {
+
+struct point {
+  int x;
+  int y;
+};
+
+using small_t = variant<int, long, unsigned, char>;
+using trivial_t = variant<int, double, point>;
+using comparable_t = variant<int, long, double>;
+
+}
+
+extern "C" {
+
+long codegen_visit_small(codegen::small_t const& v) {
+  return visit([](auto x) { return static_cast<long>(x) * 3 + 1; }, v);
+}
+
+long codegen_get_index(codegen::small_t const& v) {
+  return get<1>(v);
+}
+
+long codegen_get_unchecked(codegen::small_t const& v) {
+  return get_unchecked<1>(v);
+}
+
+void codegen_copy_trivial(codegen::trivial_t& dst, codegen::trivial_t const& src) {
+  dst = src;
+}
+
+bool codegen_equal(codegen::comparable_t const& v, codegen::comparable_t const& w) {
+  return v == w;
+}
+
+bool codegen_less(codegen::comparable_t const& v, codegen::comparable_t const& w) {
+  return v < w;
+}
+
+}
@@ -36,6 +36,16 @@ struct throwing_move_operator_t {
 
 void swap(throwing_move_operator_t&, throwing_move_operator_t&);
 
+struct throwing_copy_t {
+  throwing_copy_t() = default;
+  throwing_copy_t(const throwing_copy_t&) { // NOLINT(bugprone-exception-escape)
+    throw std::exception();
+  }
+  throwing_copy_t(throwing_copy_t&&) noexcept = default;
+  throwing_copy_t& operator=(const throwing_copy_t&) = default;
+  throwing_copy_t& operator=(throwing_copy_t&&) noexcept = default;
+};
+
 struct no_copy_t {
   no_copy_t(const no_copy_t&) = delete;
 };
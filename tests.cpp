@@ -1,12 +1,31 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <compare>
+#include <cstdint>
+#include <cstring>
 #include <exception>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <memory_resource>
+#include <span>
 #include <string>
 #include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "gtest/gtest.h"
 #include "test-classes.h"
 #include "variant.h"
+#include "variant-batch.h"
+#include "variant-mapped.h"
+#include "variant-packed-sequence.h"
+#include "variant-serialize.h"
+#include "variant-vector.h"
 
 TEST(traits, destructor) {
   using variant1 = variant<int, double, trivial_t>;
@@ -183,6 +202,22 @@ TEST(traits, variant_alternative) {
   ASSERT_TRUE(res3);
 }
 
+static_assert(sizeof(variant<char, bool>) == 2, "Index of a small variant must take one byte");
+static_assert(sizeof(variant<int, float>) == 8, "Index of a small variant must take one byte");
+static_assert(sizeof(variant<double, int, char>) == 16, "Index of a small variant must take one byte");
+static_assert(sizeof(variant<int, std::string>) == sizeof(std::string) + alignof(std::string),
+              "Index must not take more than alignment of the storage");
+static_assert(std::is_same_v<variant_impl::index_t<254>, unsigned char>, "Index type must fit 254 alternatives");
+static_assert(std::is_same_v<variant_impl::index_t<255>, unsigned short>, "Index type must reserve the npos value");
+
+TEST(traits, index_npos) {
+  variant<int, throwing_move_operator_t> v;
+  ASSERT_EQ(v.index(), 0);
+  ASSERT_THROW(v.emplace<1>(throwing_move_operator_t{}), std::exception);
+  ASSERT_TRUE(v.valueless_by_exception());
+  ASSERT_EQ(v.index(), variant_npos);
+}
+
 static_assert(variant<int>().index() == 0, "Constexpr empty ctor failed");
 static_assert(holds_alternative<int>(variant<int, double>()),
               "Constexpr empty ctor holds_alternative test failed");
@@ -577,6 +612,132 @@ TEST(visits, visit_args_forwarding) {
   ASSERT_EQ(val4, 322);
 }
 
+template <std::size_t Id>
+struct indexed_t {
+  std::size_t value = Id;
+};
+
+template <typename Sequence>
+struct indexed_variant;
+
+template <std::size_t... Ids>
+struct indexed_variant<std::index_sequence<Ids...>> {
+  using type = variant<indexed_t<Ids>...>;
+};
+
+template <std::size_t Size>
+using indexed_variant_t = typename indexed_variant<std::make_index_sequence<Size>>::type;
+
+TEST(visits, visit_large) {
+  using V = indexed_variant_t<50>;
+  std::vector<V> vars{V(in_place_index<0>), V(in_place_index<17>), V(in_place_index<31>),
+                      V(in_place_index<32>), V(in_place_index<49>)};
+  for (V const& var : vars) {
+    ASSERT_EQ(visit([](auto const& alt) { return alt.value; }, var), var.index());
+  }
+}
+
+TEST(visits, visit_multiple_large) {
+  using V = indexed_variant_t<40>;
+  using W = variant<int, long, char>;
+  V v(in_place_index<37>);
+  W w(in_place_index<1>, 5L);
+  auto sum = [](auto const& alt, auto x) { return alt.value * 10 + static_cast<std::size_t>(x); };
+  ASSERT_EQ(visit(sum, v, w), 375);
+  ASSERT_EQ(visit<long long>(sum, v, w), 375LL);
+  std::size_t calls = 0;
+  visit<void>([&](auto, auto const&, auto) { return ++calls; }, w, v, w);
+  ASSERT_EQ(calls, 1);
+}
+
+constexpr bool tree_storage_test() {
+  indexed_variant_t<150> v(in_place_index<149>);
+  indexed_variant_t<150> w = v;
+  w = indexed_variant_t<150>(in_place_index<77>);
+  return get<149>(v).value == 149 && get<77>(w).value == 77 && get_if<149>(&w) == nullptr;
+}
+
+static_assert(tree_storage_test(), "Tree storage must stay constexpr");
+static_assert(sizeof(indexed_variant_t<150>) == 2 * sizeof(std::size_t), "Tree storage must not add padding");
+
+template <std::size_t Id>
+struct named_t {
+  std::string name = std::to_string(Id);
+};
+
+template <typename Sequence>
+struct named_variant;
+
+template <std::size_t... Ids>
+struct named_variant<std::index_sequence<Ids...>> {
+  using type = variant<named_t<Ids>...>;
+};
+
+TEST(storage, tree_non_trivial) {
+  using V = typename named_variant<std::make_index_sequence<40>>::type;
+  V v(in_place_index<35>);
+  V w = v;
+  ASSERT_EQ(get<35>(w).name, "35");
+  w.emplace<2>();
+  ASSERT_EQ(get<2>(w).name, "2");
+  w = std::move(v);
+  ASSERT_EQ(get<35>(w).name, "35");
+  v = named_t<17>{};
+  ASSERT_EQ(visit([](auto const& alt) { return alt.name; }, v), "17");
+}
+
+inline std::size_t counted_destructions = 0;
+
+template <std::size_t Id>
+struct counted_destructor_t {
+  std::size_t value = Id;
+
+  ~counted_destructor_t() {
+    ++counted_destructions;
+  }
+};
+
+/* Every third alternative has a destructor, the rest are trivially destructible */
+template <std::size_t Id>
+using mixed_destructor_t = std::conditional_t<Id % 3 == 0, counted_destructor_t<Id>, indexed_t<Id>>;
+
+template <typename Sequence>
+struct mixed_destructor_variant;
+
+template <std::size_t... Ids>
+struct mixed_destructor_variant<std::index_sequence<Ids...>> {
+  using type = variant<mixed_destructor_t<Ids>...>;
+  static constexpr std::uint64_t mask = variant_impl::trivially_destructible_mask<mixed_destructor_t<Ids>...>;
+};
+
+static_assert(mixed_destructor_variant<std::make_index_sequence<8>>::mask == 0b10110110,
+              "Mask must have bits of trivially destructible alternatives");
+static_assert(mixed_destructor_variant<std::make_index_sequence<64>>::mask == 0x6db6db6db6db6db6,
+              "Mask must cover 64 alternatives");
+
+template <std::size_t Size>
+void check_mixed_destructors() {
+  using V = typename mixed_destructor_variant<std::make_index_sequence<Size>>::type;
+  counted_destructions = 0;
+  {
+    V v(in_place_index<Size - 1>);
+    v.template emplace<34>();
+    ASSERT_EQ(counted_destructions, (Size - 1) % 3 == 0 ? 1 : 0);
+    v.template emplace<33>();
+    ASSERT_EQ(counted_destructions, (Size - 1) % 3 == 0 ? 1 : 0);
+    v.template emplace<35>();
+    ASSERT_EQ(counted_destructions, (Size - 1) % 3 == 0 ? 2 : 1);
+    v = V(in_place_index<Size - 2>);
+    ASSERT_EQ(get<Size - 2>(v).value, Size - 2);
+  }
+  ASSERT_EQ(counted_destructions, ((Size - 1) % 3 == 0 ? 2 : 1) + ((Size - 2) % 3 == 0 ? 2 : 0));
+}
+
+TEST(storage, table_destroy_mixed) {
+  check_mixed_destructors<40>();
+  check_mixed_destructors<71>();
+}
+
 TEST(swap, valueless) {
   throwing_move_operator_t::swap_called = 0;
   using V = variant<int, throwing_move_operator_t>;
@@ -741,3 +902,1066 @@ TEST(relops, relational_empty) {
     ASSERT_TRUE(test_less(v2, v1, false, false));
   }
 }
+
+TEST(relops, three_way) {
+  using V = variant<int, double, std::string>;
+  ASSERT_EQ(V(1) <=> V(2), std::partial_ordering::less);
+  ASSERT_EQ(V(2.5) <=> V(2.5), std::partial_ordering::equivalent);
+  ASSERT_EQ(V(std::string("a")) <=> V(5), std::partial_ordering::greater);
+  ASSERT_EQ(V(1.0) <=> V(std::nan("")), std::partial_ordering::unordered);
+
+  V empty;
+  ASSERT_ANY_THROW(empty.emplace<std::string>(std::string("ab"), 5));
+  ASSERT_TRUE(empty.valueless_by_exception());
+  ASSERT_EQ(empty <=> V(0), std::partial_ordering::less);
+  ASSERT_EQ(V(0) <=> empty, std::partial_ordering::greater);
+  ASSERT_EQ(empty <=> empty, std::partial_ordering::equivalent);
+
+  std::vector<V> vs = {V(std::string("b")), V(3), V(1.5), V(1), V(std::string("a"))};
+  std::sort(vs.begin(), vs.end());
+  ASSERT_EQ(vs, (std::vector<V>{V(1), V(3), V(1.5), V(std::string("a")), V(std::string("b"))}));
+}
+
+TEST(relops, heterogeneous) {
+  using V = variant<int, std::string, non_trivial_int_wrapper_t>;
+  V v(std::string("b"));
+  ASSERT_TRUE(v == std::string("b"));
+  ASSERT_TRUE(std::string("b") == v);
+  ASSERT_TRUE(v != std::string("a"));
+  ASSERT_FALSE(v == 0);
+  ASSERT_TRUE(v < std::string("c"));
+  ASSERT_FALSE(v < std::string("b"));
+  ASSERT_TRUE(std::string("a") < v);
+  ASSERT_FALSE(v < 42);
+  ASSERT_TRUE(42 < v);
+  ASSERT_TRUE(v < non_trivial_int_wrapper_t(0));
+  ASSERT_FALSE(non_trivial_int_wrapper_t(0) < v);
+  ASSERT_EQ(v <=> std::string("a"), std::strong_ordering::greater);
+  ASSERT_EQ(v <=> 7, std::strong_ordering::greater);
+  ASSERT_TRUE(std::string("c") > v);
+  ASSERT_TRUE(v >= 1);
+}
+
+enum class niche_color : unsigned char { red, green, blue };
+
+template <>
+struct niche_traits<niche_color> {
+  static constexpr std::size_t count = 8;
+
+  static void set(void* p, std::size_t i) noexcept {
+    *static_cast<unsigned char*>(p) = static_cast<unsigned char>(i + 3);
+  }
+
+  static std::size_t get(void const* p) noexcept {
+    unsigned char byte = *static_cast<unsigned char const*>(p);
+    return byte < 3 ? count : byte - 3;
+  }
+};
+
+static_assert(sizeof(variant<bool, trivial_t>) == 2, "Niche layout is opt-in, bool has no niche_traits");
+static_assert(variant<bool>(true).index() == 0, "Constexpr variant<bool> failed");
+static_assert(get<0>(variant<bool>(true)), "Constexpr variant<bool> failed");
+static_assert(variant<bool, trivial_t>(in_place_index<1>).index() == 1, "Constexpr empty alternative failed");
+
+constinit variant<bool, trivial_t> constinit_empty_alternative(in_place_index<1>);
+static_assert(sizeof(variant<trivial_t, niche_color, throwing_default_t>) == 1, "Index must be kept inside enum");
+static_assert(sizeof(variant<bool, int>) == 8, "Non-empty alternatives must not share the niche");
+
+TEST(niche, bool_alternative) {
+  ASSERT_EQ(constinit_empty_alternative.index(), 1);
+  using V = variant<trivial_t, bool, throwing_default_t>;
+  V v;
+  ASSERT_EQ(v.index(), 0);
+  v = true;
+  ASSERT_EQ(v.index(), 1);
+  ASSERT_TRUE(get<1>(v));
+  v = false;
+  ASSERT_EQ(v.index(), 1);
+  ASSERT_FALSE(get<bool>(v));
+  v.emplace<0>();
+  ASSERT_EQ(v.index(), 0);
+  ASSERT_ANY_THROW(v.emplace<2>());
+  ASSERT_TRUE(v.valueless_by_exception());
+  v = false;
+  ASSERT_TRUE(holds_alternative<bool>(v));
+}
+
+TEST(niche, enum_alternative) {
+  using V = variant<trivial_t, niche_color, throwing_default_t>;
+  V v(in_place_index<1>, niche_color::blue);
+  V w = v;
+  ASSERT_EQ(w.index(), 1);
+  ASSERT_EQ(get<1>(w), niche_color::blue);
+  w = V();
+  ASSERT_EQ(w.index(), 0);
+  v.swap(w);
+  ASSERT_EQ(v.index(), 0);
+  ASSERT_EQ(get<niche_color>(w), niche_color::blue);
+  ASSERT_EQ(visit([](auto alt) { return sizeof(alt); }, w), sizeof(niche_color));
+}
+
+template <>
+inline constexpr bool enable_never_valueless<int, std::string, throwing_copy_t, throwing_default_t> = true;
+
+template <>
+inline constexpr bool enable_never_valueless<std::string, throwing_move_operator_t> = true;
+
+static_assert(sizeof(variant<int, std::string, throwing_copy_t, throwing_default_t>) ==
+                  sizeof(variant<int, std::string>),
+              "Never valueless variant with nothrow movable alternatives must not take the second storage");
+static_assert(sizeof(variant<std::string, throwing_move_operator_t>) == 2 * sizeof(std::string) + alignof(std::string),
+              "Never valueless variant with throwing move must take the second storage");
+
+TEST(never_valueless, build_aside) {
+  using V = variant<int, std::string, throwing_copy_t, throwing_default_t>;
+  V v(std::string("kept"));
+  ASSERT_ANY_THROW(v.emplace<3>());
+  ASSERT_FALSE(v.valueless_by_exception());
+  ASSERT_EQ(get<1>(v), "kept");
+  V w(in_place_index<2>);
+  ASSERT_ANY_THROW(v = w);
+  ASSERT_EQ(get<std::string>(v), "kept");
+  v = std::move(w);
+  ASSERT_EQ(v.index(), 2);
+  v = 42;
+  ASSERT_EQ(get<int>(v), 42);
+}
+
+TEST(never_valueless, double_buffered) {
+  using V = variant<std::string, throwing_move_operator_t>;
+  V v(std::string("kept"));
+  ASSERT_ANY_THROW({
+    V tmp(in_place_index<1>);
+    v = std::move(tmp);
+  });
+  ASSERT_FALSE(v.valueless_by_exception());
+  ASSERT_EQ(get<0>(v), "kept");
+  v.emplace<1>();
+  ASSERT_EQ(v.index(), 1);
+  v = std::string("back");
+  ASSERT_EQ(get<0>(v), "back");
+  V w = std::move(v);
+  ASSERT_EQ(visit([](auto const& alt) { return sizeof(alt); }, w), sizeof(std::string));
+  v.swap(w);
+  ASSERT_EQ(get<0>(v), "back");
+}
+
+TEST(unchecked, get) {
+  using V = variant<int, std::string, only_movable>;
+  V v(std::string("abc"));
+  switch (v.index()) {
+  case 1:
+    ASSERT_EQ(get_unchecked<1>(v), "abc");
+    get_unchecked<std::string>(v) += "d";
+    break;
+  default:
+    FAIL();
+  }
+  V const& cv = v;
+  ASSERT_EQ(get_unchecked<std::string>(cv), "abcd");
+  std::string moved = get_unchecked<1>(std::move(v));
+  ASSERT_EQ(moved, "abcd");
+  v.emplace<only_movable>();
+  only_movable taken = get_unchecked<only_movable>(std::move(v));
+  ASSERT_TRUE(taken.has_coin());
+  ASSERT_FALSE(get_unchecked<2>(v).has_coin());
+}
+
+TEST(unchecked, visit) {
+  using V = variant<int, long, std::string>;
+  V v(5L);
+  V w(std::string("xy"));
+  auto size = overload{[](std::string const& s) { return s.size(); }, [](auto x) { return std::size_t(x); }};
+  ASSERT_EQ(visit_unchecked(size, v), 5);
+  ASSERT_EQ(visit_unchecked(size, w), 2);
+  ASSERT_EQ(visit_unchecked<long>([](auto const&, auto const&) { return 1; }, v, w), 1L);
+}
+
+struct relocation_counter {
+  static inline std::size_t moves = 0;
+
+  explicit relocation_counter(int x) : x(x) {}
+  relocation_counter(relocation_counter&& other) noexcept : x(other.x) {
+    ++moves;
+  }
+  relocation_counter& operator=(relocation_counter&&) noexcept = default;
+
+  int x;
+};
+
+template <>
+struct is_trivially_relocatable<relocation_counter> : std::true_type {};
+
+static_assert(is_trivially_relocatable_v<variant<int, std::unique_ptr<int>>>,
+              "Variant of relocatable alternatives must be relocatable");
+static_assert(is_trivially_relocatable_v<variant<double, relocation_counter>>,
+              "Opt-in of an alternative must make the variant relocatable");
+static_assert(!is_trivially_relocatable_v<variant<int, only_movable>>,
+              "Variant with a non-relocatable alternative must not be relocatable");
+
+TEST(relocation, uninitialized_relocate) {
+  using V = variant<int, std::unique_ptr<int>, relocation_counter>;
+  relocation_counter::moves = 0;
+  constexpr std::size_t size = 5;
+  alignas(V) unsigned char from[size * sizeof(V)];
+  alignas(V) unsigned char to[size * sizeof(V)];
+  V* first = reinterpret_cast<V*>(from);
+  for (std::size_t i = 0; i < size; ++i) {
+    if (i % 3 == 0) {
+      new (first + i) V(static_cast<int>(i));
+    } else if (i % 3 == 1) {
+      new (first + i) V(std::make_unique<int>(static_cast<int>(i)));
+    } else {
+      new (first + i) V(in_place_index<2>, static_cast<int>(i));
+    }
+  }
+  V* last = uninitialized_relocate(first, first + size, reinterpret_cast<V*>(to));
+  V* moved = reinterpret_cast<V*>(to);
+  ASSERT_EQ(last, moved + size);
+  ASSERT_EQ(relocation_counter::moves, 0);
+  ASSERT_EQ(get<0>(moved[3]), 3);
+  ASSERT_EQ(*get<1>(moved[4]), 4);
+  ASSERT_EQ(get<2>(moved[2]).x, 2);
+  std::destroy(moved, last);
+}
+
+TEST(relocation, relocate_non_trivial) {
+  using V = variant<int, std::vector<int>>;
+  alignas(V) unsigned char buffer[sizeof(V)];
+  V v(std::vector<int>{1, 2, 3});
+  V* source = new (buffer) V(std::move(v));
+  V w;
+  w.~V();
+  relocate(source, &w);
+  ASSERT_EQ(get<1>(w), std::vector<int>({1, 2, 3}));
+}
+
+TEST(swap, different_alternatives_relocated) {
+  using V = variant<std::string, std::unique_ptr<int>, relocation_counter>;
+  relocation_counter::moves = 0;
+  V a(std::make_unique<int>(7));
+  V b(in_place_index<2>, 3);
+  a.swap(b);
+  ASSERT_EQ(relocation_counter::moves, 0);
+  ASSERT_EQ(get<2>(a).x, 3);
+  ASSERT_EQ(*get<1>(b), 7);
+  V c(std::string("moved"));
+  c.swap(a);
+  ASSERT_EQ(relocation_counter::moves, 2);
+  ASSERT_EQ(get<0>(a), "moved");
+  ASSERT_EQ(get<2>(c).x, 3);
+  swap(a, b);
+  ASSERT_EQ(*get<1>(a), 7);
+  ASSERT_EQ(get<0>(b), "moved");
+}
+
+struct destruction_counter {
+  static inline std::size_t destroyed = 0;
+
+  explicit destruction_counter(int x) : x(x) {}
+  destruction_counter(destruction_counter const&) = default;
+  destruction_counter& operator=(destruction_counter const&) = default;
+  ~destruction_counter() {
+    ++destroyed;
+  }
+
+  int x;
+};
+
+TEST(emplace, static_index) {
+  using V = variant<int, destruction_counter, std::string>;
+  destruction_counter::destroyed = 0;
+  V v(in_place_index<1>, 1);
+  v.emplace<1>(2);
+  ASSERT_EQ(destruction_counter::destroyed, 1);
+  ASSERT_EQ(get<1>(v).x, 2);
+  v.emplace<std::string>("str");
+  ASSERT_EQ(destruction_counter::destroyed, 2);
+  v = "other";
+  ASSERT_EQ(get<2>(v), "other");
+  v = 5;
+  ASSERT_EQ(get<0>(v), 5);
+  v = destruction_counter(3);
+  ASSERT_EQ(destruction_counter::destroyed, 3);
+  v = destruction_counter(4);
+  ASSERT_EQ(get<1>(v).x, 4);
+  ASSERT_EQ(destruction_counter::destroyed, 4);
+}
+
+static_assert(std::is_default_constructible_v<std::hash<variant<int, std::string>>>);
+static_assert(!std::is_default_constructible_v<std::hash<variant<int, std::vector<int>>>>,
+              "Hash must be disabled if any alternative is not hashable");
+
+TEST(hash, std_hash) {
+  using V = variant<int, long, std::string, int const*>;
+  std::hash<V> h;
+  ASSERT_EQ(h(V(5)), h(V(5)));
+  ASSERT_NE(h(V(5)), h(V(5L)));
+  ASSERT_EQ(h(V(std::string("abc"))), h(V(std::string("abc"))));
+
+  std::unordered_set<V> set = {V(1), V(1L), V(std::string("one")), V(nullptr)};
+  ASSERT_EQ(set.size(), 4);
+  ASSERT_TRUE(set.contains(V(1L)));
+  ASSERT_FALSE(set.contains(V(2)));
+  ASSERT_TRUE(set.contains(V(static_cast<int const*>(nullptr))));
+
+  V empty;
+  ASSERT_ANY_THROW(empty.emplace<std::string>(std::string("ab"), 5));
+  ASSERT_EQ(h(empty), h(empty));
+}
+
+TEST(hash, transparent_lookup) {
+  using V = variant<int, std::string>;
+  std::unordered_map<V, int, variant_hash<V>, variant_equal_to<V>> map;
+  map.emplace(V(1), 10);
+  map.emplace(V(std::string("two")), 20);
+
+  ASSERT_EQ(variant_hash<V>{}(std::string("two")), std::hash<V>{}(V(std::string("two"))));
+  auto it = map.find(std::string("two"));
+  ASSERT_NE(it, map.end());
+  ASSERT_EQ(it->second, 20);
+  ASSERT_EQ(map.find(1)->second, 10);
+  ASSERT_EQ(map.find(2), map.end());
+  ASSERT_EQ(map.find(std::string("one")), map.end());
+  ASSERT_TRUE(map.contains(1));
+}
+
+TEST(variant_vector, push_and_access) {
+  using V = variant<int, std::string, double>;
+  variant_vector<int, std::string, double> vec;
+  vec.push_back(V(1));
+  vec.push_back(std::string("two"));
+  vec.emplace_back<2>(3.5);
+  vec.emplace_back<std::string>(3, 'x');
+  ASSERT_EQ(vec.size(), 4);
+  ASSERT_EQ(vec[0].index(), 0);
+  ASSERT_EQ(vec[0].get<int>(), 1);
+  ASSERT_EQ(vec[1].get<1>(), "two");
+  ASSERT_EQ(vec[2].get<double>(), 3.5);
+  ASSERT_EQ(vec.back().get<std::string>(), "xxx");
+  ASSERT_TRUE(vec[1].holds_alternative<std::string>());
+  ASSERT_EQ(vec[1].get_if<int>(), nullptr);
+  ASSERT_THROW(vec[1].get<int>(), bad_variant_access);
+  ASSERT_THROW(vec.at(4), std::out_of_range);
+
+  auto element = vec[1];
+  decltype(vec)::const_reference const_element = element;
+  element.get<std::string>() += "!";
+  ASSERT_EQ(const_element.get<1>(), "two!");
+  ASSERT_EQ(static_cast<V>(vec[1]), V(std::string("two!")));
+  ASSERT_EQ(vec[2].visit([](auto const& x) { return sizeof(x); }), sizeof(double));
+
+  V empty;
+  ASSERT_ANY_THROW(empty.emplace<std::string>(std::string("ab"), 5));
+  ASSERT_THROW(vec.push_back(empty), bad_variant_access);
+  ASSERT_EQ(vec.size(), 4);
+
+  vec.pop_back();
+  ASSERT_EQ(vec.size(), 3);
+  vec.clear();
+  ASSERT_TRUE(vec.empty());
+}
+
+TEST(variant_vector, growth) {
+  variant_vector<int, std::string> strings;
+  for (int i = 0; i < 100; ++i) {
+    if (i % 2 == 0) {
+      strings.push_back(i);
+    } else {
+      strings.push_back(std::string(20, static_cast<char>('a' + i % 26)));
+    }
+  }
+  strings.push_back(strings[1].get<std::string>());
+  ASSERT_EQ(strings.size(), 101);
+  ASSERT_EQ(strings[98].get<int>(), 98);
+  ASSERT_EQ(strings[99].get<std::string>(), std::string(20, 'a' + 99 % 26));
+  ASSERT_EQ(strings[100].get<std::string>(), std::string(20, 'b'));
+
+  relocation_counter::moves = 0;
+  variant_vector<int, relocation_counter> counters;
+  for (int i = 0; i < 100; ++i) {
+    counters.emplace_back<relocation_counter>(i);
+  }
+  ASSERT_EQ(relocation_counter::moves, 0);
+  ASSERT_EQ(counters[77].get<relocation_counter>().x, 77);
+}
+
+struct copy_budget_t {
+  static inline int budget = 0;
+
+  explicit copy_budget_t(int x) : x(x) {}
+  copy_budget_t(copy_budget_t const& other) : x(other.x) {
+    if (budget-- == 0) {
+      throw std::exception();
+    }
+  }
+  copy_budget_t(copy_budget_t&& other) : x(other.x) {} // NOLINT(performance-noexcept-move-constructor)
+
+  int x;
+};
+
+TEST(variant_vector, growth_strong_guarantee) {
+  variant_vector<copy_budget_t, std::string> vec;
+  vec.reserve(4);
+  for (int i = 0; i < 4; ++i) {
+    vec.emplace_back<0>(i);
+  }
+  copy_budget_t::budget = 2;
+  ASSERT_ANY_THROW(vec.emplace_back<1>("new"));
+  ASSERT_EQ(vec.size(), 4);
+  ASSERT_EQ(vec.capacity(), 4);
+  ASSERT_EQ(vec[3].get<0>().x, 3);
+
+  copy_budget_t::budget = 4;
+  vec.emplace_back<1>("new");
+  ASSERT_EQ(vec.size(), 5);
+  ASSERT_EQ(vec[2].get<0>().x, 2);
+}
+
+TEST(variant_vector, visit_each_and_copy) {
+  variant_vector<int, std::string> vec;
+  for (int i = 0; i < 10; ++i) {
+    vec.push_back(i);
+    vec.push_back(std::to_string(i));
+  }
+  std::size_t ints = 0;
+  std::size_t chars = 0;
+  vec.visit_each([&]<typename T>(T const& x) {
+    if constexpr (std::is_same_v<T, int>) {
+      ints += x;
+    } else {
+      chars += x.size();
+    }
+  });
+  ASSERT_EQ(ints, 45);
+  ASSERT_EQ(chars, 10);
+
+  variant_vector<int, std::string> copy = vec;
+  vec.visit_each([](auto& x) { x = std::remove_reference_t<decltype(x)>(); });
+  ASSERT_EQ(copy[19].get<std::string>(), "9");
+  ASSERT_EQ(vec[19].get<std::string>(), "");
+
+  variant_vector<int, std::string> moved = std::move(copy);
+  ASSERT_EQ(moved.size(), 20);
+  ASSERT_TRUE(copy.empty()); // NOLINT(bugprone-use-after-move)
+  copy = moved;
+  ASSERT_EQ(copy[18].get<int>(), 9);
+}
+
+TEST(visit_batched, grouped) {
+  using V = variant<int, std::string, double>;
+  std::vector<V> values = {V(1), V(std::string("a")), V(2.5), V(2), V(std::string("b")), V(3)};
+  std::vector<std::string> calls;
+  visit_batched(values, [&]<typename T>(T const& x) {
+    if constexpr (std::is_same_v<T, std::string>) {
+      calls.push_back(x);
+    } else {
+      calls.push_back(std::to_string(static_cast<int>(x)));
+    }
+  });
+  ASSERT_EQ(calls, (std::vector<std::string>{"1", "2", "3", "a", "b", "2"}));
+
+  visit_batched(values, [](auto& x) { x += x; });
+  ASSERT_EQ(get<std::string>(values[4]), "bb");
+  ASSERT_EQ(get<int>(values[5]), 6);
+}
+
+TEST(visit_batched, grouped_many) {
+  using V = variant<int, long, double>;
+  std::vector<V> values;
+  for (int i = 0; i < 2000; ++i) {
+    if (i % 7 == 0) {
+      values.emplace_back(static_cast<long>(i));
+    } else if (i % 3 == 0) {
+      values.emplace_back(static_cast<double>(i));
+    } else {
+      values.emplace_back(i);
+    }
+  }
+  std::vector<double> seen[3];
+  visit_batched(values, [&]<typename T>(T const& x) {
+    seen[std::is_same_v<T, int> ? 0 : std::is_same_v<T, long> ? 1 : 2].push_back(static_cast<double>(x));
+  });
+  ASSERT_EQ(seen[0].size() + seen[1].size() + seen[2].size(), values.size());
+  for (auto const& s : seen) {
+    ASSERT_TRUE(std::is_sorted(s.begin(), s.end()));
+  }
+}
+
+TEST(visit_batched, original_order) {
+  using V = variant<int, long>;
+  std::list<V> const values = {V(1), V(2), V(3L), V(4L), V(5), V(6L)};
+  std::vector<long> calls;
+  visit_batched(values, [&](auto const& x) { calls.push_back(x); }, batch_order::original);
+  ASSERT_EQ(calls, (std::vector<long>{1, 2, 3, 4, 5, 6}));
+}
+
+TEST(visit_batched, valueless) {
+  using V = variant<int, std::string>;
+  std::vector<V> values = {V(1), V(2), V(std::string("a"))};
+  ASSERT_ANY_THROW(values[1].emplace<std::string>(std::string("ab"), 5));
+  std::size_t calls = 0;
+  ASSERT_THROW(visit_batched(values, [&](auto const&) { ++calls; }), bad_variant_access);
+  ASSERT_EQ(calls, 0);
+  ASSERT_THROW(visit_batched(values, [&](auto const&) { ++calls; }, batch_order::original), bad_variant_access);
+  ASSERT_EQ(calls, 1);
+
+  std::vector<V> empty;
+  visit_batched(empty, [&](auto const&) { ++calls; });
+  ASSERT_EQ(calls, 1);
+}
+
+struct telemetry_record {
+  char payload[200];
+};
+
+TEST(packed_variant_sequence, compact_layout) {
+  packed_variant_sequence<int, telemetry_record> seq;
+  for (int i = 0; i < 95; ++i) {
+    seq.push_back(i);
+  }
+  for (int i = 0; i < 5; ++i) {
+    seq.emplace_back<telemetry_record>();
+  }
+  ASSERT_EQ(seq.size(), 100);
+  ASSERT_EQ(seq.bytes(), 95 * 8 + 5 * 201);
+  ASSERT_LT(seq.bytes() * 5, seq.size() * sizeof(variant<int, telemetry_record>));
+
+  int sum = 0;
+  std::size_t records = 0;
+  for (auto element : seq) {
+    if (auto const* x = element.get_if<int>()) {
+      sum += *x;
+    } else {
+      ++records;
+    }
+  }
+  ASSERT_EQ(sum, 94 * 95 / 2);
+  ASSERT_EQ(records, 5);
+}
+
+TEST(packed_variant_sequence, side_index) {
+  packed_variant_sequence<char, std::string, double> seq;
+  seq.push_back('a');
+  seq.push_back(std::string("b"));
+  ASSERT_FALSE(seq.has_index());
+  ASSERT_THROW(seq.at(0), std::logic_error);
+  seq.enable_index();
+  for (int i = 0; i < 1000; ++i) {
+    seq.push_back(static_cast<double>(i));
+    seq.emplace_back<std::string>(std::to_string(i));
+  }
+  ASSERT_EQ(seq.at(0).get<char>(), 'a');
+  ASSERT_EQ(seq[1].get<std::string>(), "b");
+  ASSERT_EQ(seq[2 + 2 * 500].get<double>(), 500.0);
+  ASSERT_EQ(seq[3 + 2 * 999].get<std::string>(), "999");
+  ASSERT_THROW(seq.at(seq.size()), std::out_of_range);
+
+  packed_variant_sequence<char, std::string, double> copy = seq;
+  seq.clear();
+  ASSERT_TRUE(seq.empty());
+  ASSERT_EQ(std::distance(seq.begin(), seq.end()), 0);
+  ASSERT_EQ(copy[3 + 2 * 999].get<std::string>(), "999");
+  ASSERT_EQ((static_cast<variant<char, std::string, double>>(copy[2])), (variant<char, std::string, double>(0.0)));
+
+  std::size_t chars = 0;
+  copy.visit_each([&]<typename T>(T const& x) {
+    if constexpr (std::is_same_v<T, std::string>) {
+      chars += x.size();
+    }
+  });
+  ASSERT_EQ(chars, 1 + 10 + 90 * 2 + 900 * 3);
+}
+
+TEST(packed_variant_sequence, growth_strong_guarantee) {
+  packed_variant_sequence<copy_budget_t, std::string> seq;
+  seq.reserve_bytes(4 * sizeof(copy_budget_t) + 4);
+  std::size_t capacity = seq.capacity_bytes();
+  while (seq.bytes() + 8 <= capacity) {
+    seq.emplace_back<0>(static_cast<int>(seq.size()));
+  }
+  std::size_t size = seq.size();
+  copy_budget_t::budget = 1;
+  ASSERT_ANY_THROW(seq.emplace_back<1>(std::string(100, 'x')));
+  ASSERT_EQ(seq.size(), size);
+  ASSERT_EQ(seq.capacity_bytes(), capacity);
+
+  copy_budget_t::budget = static_cast<int>(size);
+  seq.emplace_back<1>(std::string(100, 'x'));
+  std::size_t count = 0;
+  seq.visit_each([&](auto const&) { ++count; });
+  ASSERT_EQ(count, size + 1);
+}
+
+TEST(packed_variant_sequence, indexed_appends) {
+  packed_variant_sequence<int, double, copy_budget_t> seq;
+  seq.enable_index();
+  constexpr int count = 200000;
+  for (int i = 0; i < count; ++i) {
+    if (i % 2 == 0) {
+      seq.push_back(i);
+    } else {
+      seq.emplace_back<double>(i);
+    }
+  }
+  ASSERT_EQ(seq.size(), count);
+  ASSERT_EQ(seq[count - 2].get<int>(), count - 2);
+  ASSERT_EQ(seq[count - 1].get<double>(), count - 1);
+
+  copy_budget_t::budget = 0;
+  copy_budget_t throwing(0);
+  ASSERT_ANY_THROW(seq.emplace_back<copy_budget_t>(throwing));
+  ASSERT_EQ(seq.size(), count);
+  seq.push_back(7);
+  ASSERT_EQ(seq[count].get<int>(), 7);
+  ASSERT_EQ(seq.at(count - 1).get<double>(), count - 1);
+}
+
+using big_payload = std::array<char, 256>;
+
+static_assert(std::is_same_v<variant_boxed<16, int, big_payload, std::string>,
+                             variant<int, box<big_payload>, box<std::string>>>);
+static_assert(sizeof(variant<int, box<big_payload>>) == 2 * sizeof(void*));
+static_assert(std::is_same_v<variant_alternative_t<1, variant<int, box<big_payload>>>, big_payload>);
+static_assert(is_trivially_relocatable_v<variant<int, box<std::string>>>,
+              "Box with std::allocator must be relocatable as a pointer");
+
+template <typename T>
+struct counting_allocator {
+  using value_type = T;
+
+  static inline int allocations = 0;
+  static inline int deallocations = 0;
+
+  counting_allocator() = default;
+
+  template <typename U>
+  counting_allocator(counting_allocator<U> const&) noexcept {}
+
+  T* allocate(std::size_t n) {
+    ++allocations;
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T* p, std::size_t n) noexcept {
+    ++deallocations;
+    std::allocator<T>().deallocate(p, n);
+  }
+
+  friend bool operator==(counting_allocator const&, counting_allocator const&) = default;
+};
+
+TEST(box, access_as_alternative) {
+  using var = variant<int, box<std::string>>;
+  var v(std::string("boxed"));
+  ASSERT_EQ(v.index(), 1);
+  ASSERT_TRUE(holds_alternative<std::string>(v));
+  ASSERT_EQ(get<std::string>(v), "boxed");
+  ASSERT_EQ(get<1>(v), "boxed");
+  ASSERT_EQ(*get_if<std::string>(&v), "boxed");
+
+  std::string* address = &get<std::string>(v);
+  v = std::string("assigned in place");
+  ASSERT_EQ(&get<std::string>(v), address);
+  ASSERT_EQ(visit([](auto const& x) -> std::size_t {
+              if constexpr (std::is_same_v<std::remove_cvref_t<decltype(x)>, std::string>) {
+                return x.size();
+              } else {
+                return 0;
+              }
+            }, v), 17);
+
+  std::string& emplaced = v.emplace<std::string>(3, 'x');
+  ASSERT_EQ(emplaced, "xxx");
+  v = 5;
+  ASSERT_EQ(get<int>(v), 5);
+  ASSERT_TRUE(v < var(std::string()));
+  ASSERT_TRUE(var(std::string("a")) == std::string("a"));
+  ASSERT_EQ(std::hash<var>{}(var(std::string("a"))),
+            (std::hash<variant<int, std::string>>{}(variant<int, std::string>(std::string("a")))));
+}
+
+TEST(box, copy_and_move) {
+  using var = variant<int, box<std::string>>;
+  var v(std::string(100, 'a'));
+  var copy = v;
+  ASSERT_NE(&get<std::string>(copy), &get<std::string>(v));
+  ASSERT_EQ(copy, v);
+
+  std::string const* address = &get<std::string>(v);
+  var moved = std::move(v);
+  ASSERT_EQ(&get<std::string>(moved), address);
+
+  var other(1);
+  other.swap(moved);
+  ASSERT_EQ(&get<std::string>(other), address);
+  ASSERT_EQ(get<int>(moved), 1);
+
+  variant_vector<int, box<std::string>> vec;
+  for (int i = 0; i < 100; ++i) {
+    vec.push_back(copy);
+    vec.emplace_back<int>(i);
+  }
+  ASSERT_EQ(vec[198].get<std::string>(), std::string(100, 'a'));
+}
+
+TEST(box, moved_from_is_valueless) {
+  using var = variant<int, box<std::string>>;
+  var v(std::string("boxed"));
+  var moved = std::move(v);
+  ASSERT_TRUE(v.valueless_by_exception());
+  ASSERT_EQ(v.index(), variant_npos);
+  ASSERT_THROW(get<std::string>(v), bad_variant_access);
+  ASSERT_THROW(visit([](auto const&) {}, v), bad_variant_access);
+  ASSERT_NE(v, moved);
+  ASSERT_LT(v, moved);
+  ASSERT_EQ(std::hash<var>{}(v), std::hash<var>{}(var(std::move(v))));
+
+  var target(std::string("old"));
+  target = std::move(moved);
+  ASSERT_EQ(get<std::string>(target), "boxed");
+  ASSERT_TRUE(moved.valueless_by_exception());
+  var other(std::string("new"));
+  target = std::move(other);
+  ASSERT_EQ(get<std::string>(target), "new");
+  ASSERT_TRUE(other.valueless_by_exception());
+  var number(3);
+  number = std::move(target);
+  ASSERT_EQ(get<std::string>(number), "new");
+  ASSERT_TRUE(target.valueless_by_exception());
+
+  v = 5;
+  ASSERT_EQ(get<int>(v), 5);
+  var from_int = std::move(v);
+  ASSERT_EQ(get<int>(v), 5);
+}
+
+TEST(box, custom_allocator) {
+  using alloc_t = counting_allocator<std::string>;
+  using var = variant<int, box<std::string, alloc_t>>;
+  alloc_t::allocations = 0;
+  alloc_t::deallocations = 0;
+  {
+    var v(std::string("counted"));
+    ASSERT_EQ(alloc_t::allocations, 1);
+    var copy = v;
+    ASSERT_EQ(alloc_t::allocations, 2);
+    var moved = std::move(copy);
+    ASSERT_EQ(alloc_t::allocations, 2);
+    moved = 1;
+    ASSERT_EQ(alloc_t::deallocations, 1);
+    v.emplace<1>(std::allocator_arg, alloc_t(), "with allocator");
+    ASSERT_EQ(get<std::string>(v), "with allocator");
+    ASSERT_EQ(alloc_t::allocations, 3);
+  }
+  ASSERT_EQ(alloc_t::deallocations, alloc_t::allocations);
+}
+
+struct binary_expr;
+using expr = variant<int, recursive_wrapper<binary_expr>>;
+
+struct binary_expr {
+  char op;
+  expr lhs;
+  expr rhs;
+};
+
+int evaluate(expr const& e) {
+  return visit(overload{
+      [](int x) { return x; },
+      [](binary_expr const& b) {
+        return b.op == '+' ? evaluate(b.lhs) + evaluate(b.rhs) : evaluate(b.lhs) * evaluate(b.rhs);
+      }},
+      e);
+}
+
+TEST(recursive_wrapper, expression_tree) {
+  expr e = binary_expr{'+', 1, binary_expr{'*', 2, 3}};
+  ASSERT_EQ(evaluate(e), 7);
+  ASSERT_TRUE(holds_alternative<binary_expr>(e));
+  ASSERT_EQ(get<int>(get<binary_expr>(e).lhs), 1);
+
+  expr copy = e;
+  get<binary_expr>(copy).op = '*';
+  ASSERT_EQ(evaluate(copy), 6);
+  ASSERT_EQ(evaluate(e), 7);
+
+  get<binary_expr>(e).rhs = get<binary_expr>(e).lhs;
+  ASSERT_EQ(evaluate(e), 2);
+  e = std::move(copy);
+  ASSERT_EQ(evaluate(e), 6);
+}
+
+struct arena_node;
+using arena_tree = variant<int, recursive_wrapper<arena_node, std::pmr::polymorphic_allocator<arena_node>>>;
+
+struct arena_node {
+  arena_tree left;
+  arena_tree right;
+};
+
+arena_tree build_arena_tree(int depth, std::pmr::memory_resource* resource) {
+  if (depth == 0) {
+    return arena_tree(1);
+  }
+  using wrapper = recursive_wrapper<arena_node, std::pmr::polymorphic_allocator<arena_node>>;
+  return arena_tree(wrapper(std::allocator_arg, resource,
+                            build_arena_tree(depth - 1, resource), build_arena_tree(depth - 1, resource)));
+}
+
+int count_leaves(arena_tree const& tree) {
+  if (auto node = get_if<arena_node>(&tree)) {
+    return count_leaves(node->left) + count_leaves(node->right);
+  }
+  return get<int>(tree);
+}
+
+struct counting_resource : std::pmr::memory_resource {
+  int allocations = 0;
+  int deallocations = 0;
+
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+    ++allocations;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+    ++deallocations;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+TEST(recursive_wrapper, arena) {
+  counting_resource upstream;
+  {
+    std::pmr::monotonic_buffer_resource arena(std::size_t(1) << 20, &upstream);
+    arena_tree tree = build_arena_tree(14, &arena);
+    ASSERT_EQ(count_leaves(tree), 1 << 14);
+    ASSERT_EQ(upstream.allocations, 1);
+  }
+  ASSERT_EQ(upstream.deallocations, upstream.allocations);
+}
+
+struct wire_point {
+  int x;
+  int y;
+
+  bool operator==(wire_point const&) const = default;
+};
+
+/* Neither copyable nor movable, so it can only be decoded in the storage of the variant */
+struct wire_pinned {
+  explicit wire_pinned(int value) : value(value), self(this) {}
+  wire_pinned(wire_pinned const&) = delete;
+  wire_pinned& operator=(wire_pinned const&) = delete;
+
+  int value;
+  wire_pinned* self;
+};
+
+template <>
+struct variant_serializer<wire_pinned> {
+  static constexpr std::uint32_t version = 2;
+
+  static std::size_t size(wire_pinned const&) noexcept {
+    return sizeof(int);
+  }
+
+  static void write(wire_pinned const& value, std::byte* out) noexcept {
+    std::memcpy(out, &value.value, sizeof(int));
+  }
+
+  static std::size_t read(std::span<std::byte const> in, void* place) {
+    int value;
+    if (in.size() < sizeof(value)) {
+      throw bad_variant_encoding("truncated pinned");
+    }
+    std::memcpy(&value, in.data(), sizeof(value));
+    new (place) wire_pinned(value);
+    return sizeof(value);
+  }
+};
+
+static_assert(!std::is_constructible_v<variant<int, std::string>, variant_impl::valueless_construct_t>,
+              "Valueless constructor is only for the library");
+
+TEST(serialize, raw_round_trip) {
+  using var = variant<int, double, wire_point>;
+  std::array<std::byte, 64> buffer{};
+  var v(wire_point{3, 4});
+  std::size_t size = serialize(v, buffer);
+  ASSERT_EQ(size, sizeof(std::uint32_t) + 1 + sizeof(wire_point));
+  ASSERT_EQ(serialized_size(v), size);
+  ASSERT_EQ(deserialize<var>(std::span(buffer).first(size)), v);
+  ASSERT_THROW(serialize(v, std::span(buffer).first(size - 1)), std::length_error);
+
+  var out(1.5);
+  ASSERT_EQ(deserialize(buffer, out), size);
+  ASSERT_EQ(get<wire_point>(out), (wire_point{3, 4}));
+}
+
+TEST(serialize, strings_back_to_back) {
+  using var = variant<int, std::string>;
+  std::vector<std::byte> buffer(256);
+  std::size_t used = serialize(var(std::string("first message")), buffer);
+  used += serialize(var(42), std::span(buffer).subspan(used));
+  used += serialize(var(std::string()), std::span(buffer).subspan(used));
+
+  std::span<std::byte const> in(buffer.data(), used);
+  var v;
+  in = in.subspan(deserialize(in, v));
+  ASSERT_EQ(get<std::string>(v), "first message");
+  in = in.subspan(deserialize(in, v));
+  ASSERT_EQ(get<int>(v), 42);
+  in = in.subspan(deserialize(in, v));
+  ASSERT_EQ(get<std::string>(v), "");
+  ASSERT_TRUE(in.empty());
+}
+
+TEST(serialize, rejects_mismatch) {
+  static_assert(variant_fingerprint_v<variant<int, double>> != variant_fingerprint_v<variant<double, int>>);
+  static_assert(variant_fingerprint_v<variant<int, double>> != variant_fingerprint_v<variant<int, float>>);
+
+  std::array<std::byte, 32> buffer{};
+  std::size_t size = serialize(variant<int, double>(2.5), buffer);
+  ASSERT_THROW((deserialize<variant<int, float>>(buffer)), bad_variant_encoding);
+  ASSERT_THROW((deserialize<variant<int, double>>(std::span(buffer).first(size - 1))), bad_variant_encoding);
+
+  variant<int, double> out(7);
+  buffer[sizeof(std::uint32_t)] = std::byte{2};
+  ASSERT_THROW(deserialize(buffer, out), bad_variant_encoding);
+  ASSERT_EQ(get<int>(out), 7);
+
+  serialize(variant<bool, double>(true), buffer);
+  buffer[sizeof(std::uint32_t) + 1] = std::byte{5};
+  ASSERT_THROW((deserialize<variant<bool, double>>(buffer)), bad_variant_encoding);
+}
+
+TEST(serialize, custom_in_place) {
+  using var = variant<int, wire_pinned>;
+  static_assert(variant_fingerprint_v<var> != variant_fingerprint_v<variant<int, wire_point>>);
+  std::array<std::byte, 32> buffer{};
+  var v(in_place_type<wire_pinned>, 17);
+  std::size_t size = serialize(v, buffer);
+  ASSERT_EQ(size, sizeof(std::uint32_t) + 1 + sizeof(int));
+
+  var out(0);
+  ASSERT_EQ(deserialize(buffer, out), size);
+  ASSERT_EQ(get<wire_pinned>(out).value, 17);
+  ASSERT_EQ(get<wire_pinned>(out).self, &get<wire_pinned>(out));
+}
+
+struct market_quote {
+  double bid;
+  double ask;
+  int level;
+
+  bool operator==(market_quote const&) const = default;
+};
+
+struct market_trade {
+  double price;
+  std::int64_t quantity;
+
+  bool operator==(market_trade const&) const = default;
+};
+
+struct market_heartbeat {
+  std::uint16_t source;
+
+  bool operator==(market_heartbeat const&) const = default;
+};
+
+using market_record = variant<market_quote, market_trade, market_heartbeat>;
+using market_span = mapped_variant_span<market_quote, market_trade, market_heartbeat>;
+
+static_assert(market_span::layout::payload_offset == 8);
+static_assert(market_span::layout::record_size == 8 + sizeof(market_quote));
+static_assert(market_span::layout::data_offset == 8);
+
+std::vector<market_record> market_records() {
+  std::vector<market_record> records;
+  for (int i = 0; i < 1000; ++i) {
+    switch (i % 3) {
+      case 0:
+        records.emplace_back(market_quote{100.0 + i, 101.0 + i, i});
+        break;
+      case 1:
+        records.emplace_back(market_trade{100.5 + i, i * 10});
+        break;
+      default:
+        records.emplace_back(market_heartbeat{static_cast<std::uint16_t>(i)});
+    }
+  }
+  return records;
+}
+
+TEST(mapped_variant_span, visit_in_place) {
+  std::vector<market_record> records = market_records();
+  std::vector<std::byte> image = market_span::image(records);
+  market_span view(image);
+  ASSERT_EQ(view.size(), records.size());
+  ASSERT_EQ(view.index(4), 1);
+  ASSERT_EQ(view.get_if<market_trade>(4)->quantity, 40);
+  ASSERT_EQ(view.get_if<market_quote>(4), nullptr);
+  ASSERT_EQ(reinterpret_cast<std::byte const*>(view.get_if<0>(3)),
+            image.data() + market_span::layout::data_offset + 3 * market_span::layout::record_size + 8);
+  ASSERT_EQ(view[998], records[998]);
+
+  std::int64_t quantity = 0;
+  view.visit_each(overload{[](market_quote const&) {},
+                           [&](market_trade const& t) { quantity += t.quantity; },
+                           [](market_heartbeat const&) {}});
+  ASSERT_EQ(quantity, 10 * (333 * 334 / 2 * 3 - 333 * 2));
+  ASSERT_EQ(view.visit(5, [](auto const& r) { return sizeof(r); }), sizeof(market_heartbeat));
+}
+
+TEST(mapped_variant_span, rejects_bad_images) {
+  std::vector<market_record> records = market_records();
+  std::vector<std::byte> image = market_span::image(records);
+
+  std::vector<std::byte> truncated(image.begin(), image.end() - 1);
+  ASSERT_THROW(market_span{truncated}, bad_variant_encoding);
+
+  std::vector<std::byte> bad_tag = image;
+  bad_tag[market_span::layout::data_offset + 500 * market_span::layout::record_size] = std::byte{3};
+  ASSERT_THROW(market_span{bad_tag}, bad_variant_encoding);
+
+  using other_span = mapped_variant_span<market_trade, market_quote, market_heartbeat>;
+  ASSERT_THROW(other_span{image}, bad_variant_encoding);
+
+  using flag_span = mapped_variant_span<bool, int>;
+  std::vector<variant<bool, int>> flags = {true, 7, false};
+  std::vector<std::byte> flag_image = flag_span::image(flags);
+  ASSERT_FALSE(*flag_span{flag_image}.get_if<bool>(2));
+  flag_image[flag_span::layout::data_offset + 2 * flag_span::layout::record_size +
+             flag_span::layout::payload_offset] = std::byte{2};
+  ASSERT_THROW(flag_span{flag_image}, bad_variant_encoding);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+TEST(mapped_variant_span, temp_file) {
+  std::vector<market_record> records = market_records();
+  std::vector<std::byte> image = market_span::image(records);
+  std::string path = (std::filesystem::temp_directory_path() /
+                      ("mapped_variant_span_" + std::to_string(::getpid()) + ".bin")).string();
+  {
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<char const*>(image.data()), static_cast<std::streamsize>(image.size()));
+  }
+  {
+    mapped_file file(path);
+    market_span view(file.bytes());
+    ASSERT_EQ(view.size(), records.size());
+    for (std::size_t i = 0; i < records.size(); ++i) {
+      ASSERT_EQ(view[i], records[i]);
+    }
+  }
+  std::filesystem::remove(path);
+  ASSERT_THROW(mapped_file{path}, std::system_error);
+}
+#endif
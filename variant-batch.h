@@ -0,0 +1,105 @@
+#pragma once
+
+#include "variant.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+
+
+/* Order in which visit_batched calls the visitor */
+enum class batch_order {
+  /* Elements are gathered into batches holding the same alternative, a batch is visited when it fills up
+   * and the rest at the end. Elements holding the same alternative keep their relative order */
+  grouped,
+  /* Order of the range: every run of consecutive elements holding the same alternative
+   * is dispatched once and visited in a loop. Pays off when the range has long runs */
+  original,
+};
+
+
+namespace variant_impl {
+
+template <typename Range>
+using range_variant_t = std::remove_cvref_t<std::ranges::range_reference_t<Range>>;
+
+template <typename Range>
+concept VariantRange = std::ranges::forward_range<Range> &&
+                       std::is_lvalue_reference_v<std::ranges::range_reference_t<Range>> &&
+                       is_variant_specialization<range_variant_t<Range>>::value;
+
+template <std::size_t Id, typename Element, typename Visitor>
+void visit_group(Element* const* first, Element* const* last, Visitor& vis) {
+  for (; first != last; ++first) {
+    vis(unbox(get<Id>((*first)->current_storage())));
+  }
+}
+
+/* Pointers to elements are collected into a bucket per alternative on the stack, a full bucket is visited
+ * in one loop without dispatch per element. Buckets hold 1024 pointers together, but from 16 to 256 each */
+template <typename Range, typename Visitor, std::size_t... Ids>
+void visit_grouped(Range& range, Visitor& vis, std::index_sequence<Ids...>) {
+  using element_t = std::remove_reference_t<std::ranges::range_reference_t<Range>>;
+  constexpr std::size_t count = sizeof...(Ids);
+  constexpr std::size_t capacity = std::clamp<std::size_t>(1024 / count, 16, 256);
+
+  element_t* buckets[count][capacity];
+  std::size_t fill[count] = {};
+  for (element_t& v : range) {
+    std::size_t index = v.index();
+    if (index == variant_npos) {
+      throw bad_variant_access("invoke visit on valueless variant");
+    }
+    buckets[index][fill[index]++] = std::addressof(v);
+    if (fill[index] == capacity) {
+      fill[index] = 0;
+      dispatch<void, count>(index, [&](auto id) {
+        visit_group<id>(buckets[id], buckets[id] + capacity, vis);
+      });
+    }
+  }
+  (visit_group<Ids>(buckets[Ids], buckets[Ids] + fill[Ids], vis), ...);
+}
+
+template <typename Range, typename Visitor>
+void visit_runs(Range& range, Visitor& vis) {
+  using variant_t = range_variant_t<Range>;
+  auto it = std::ranges::begin(range);
+  auto end = std::ranges::end(range);
+  while (it != end) {
+    std::size_t index = (*it).index();
+    if (index == variant_npos) {
+      throw bad_variant_access("invoke visit on valueless variant");
+    }
+    auto run_end = std::next(it);
+    while (run_end != end && (*run_end).index() == index) {
+      ++run_end;
+    }
+    dispatch<void, variant_size_v<variant_t>>(index, [&](auto id) {
+      for (; it != run_end; ++it) {
+        vis(unbox(get<id>((*it).current_storage())));
+      }
+    });
+  }
+}
+
+}
+
+
+/* Visits every element of a range of variants with one dispatch per batch instead of one per element.
+ * The visitor is called with lvalues of the alternatives, its results are discarded.
+ * Throws bad_variant_access if an element is valueless, some elements may have been visited by then */
+template <typename Range, typename Visitor>
+  requires(variant_impl::VariantRange<Range>)
+void visit_batched(Range&& range, Visitor&& vis, batch_order order = batch_order::grouped) {
+  using variant_t = variant_impl::range_variant_t<Range>;
+  if (order == batch_order::grouped) {
+    variant_impl::visit_grouped(range, vis, std::make_index_sequence<variant_size_v<variant_t>>());
+  } else {
+    variant_impl::visit_runs(range, vis);
+  }
+}
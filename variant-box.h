@@ -0,0 +1,316 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+
+template <typename... Types>
+struct variant;
+
+
+/* Alternative marker: variant<int, box<Big>> keeps Big on the heap and only a pointer inline.
+ * get<Big>, get_if<Big>, holds_alternative<Big>, visit, comparisons and hash see the alternative as Big,
+ * copies are deep, memory comes from Allocator. Moved-from box owns nothing, like moved-from std::indirect
+ * it may only be assigned to or destroyed. A variant moved from such a box is left valueless, so it can't
+ * be used with the never valueless policy */
+template <typename T, typename Allocator = std::allocator<T>>
+class box;
+
+/* Alternative marker for recursive types: variant<int, recursive_wrapper<Node>> may be a member of Node.
+ * Same as box, but copy and assignment are not constrained on T, so T may be incomplete where the variant is declared.
+ * With std::pmr::polymorphic_allocator over a monotonic resource a whole tree takes a few bulk allocations */
+template <typename T, typename Allocator = std::allocator<T>>
+class recursive_wrapper;
+
+
+namespace variant_impl {
+
+template <typename T>
+struct unboxed {
+  using type = T;
+};
+
+template <typename T, typename Allocator>
+struct unboxed<box<T, Allocator>> {
+  using type = T;
+};
+
+template <typename T, typename Allocator>
+struct unboxed<const box<T, Allocator>> {
+  using type = const T;
+};
+
+template <typename T, typename Allocator>
+struct unboxed<recursive_wrapper<T, Allocator>> {
+  using type = T;
+};
+
+template <typename T, typename Allocator>
+struct unboxed<const recursive_wrapper<T, Allocator>> {
+  using type = const T;
+};
+
+/* Type the alternative is seen as by get and visit */
+template <typename T>
+using unboxed_t = typename unboxed<T>::type;
+
+template <typename T>
+inline constexpr bool is_boxed = !std::is_same_v<unboxed_t<T>, T>;
+
+/* Arguments the generic constructor leaves to the copy, move and allocator-extended constructors */
+template <typename... Args>
+inline constexpr bool reserved_box_arguments = false;
+
+template <typename Arg, typename... Args>
+inline constexpr bool reserved_box_arguments<Arg, Args...> =
+    std::is_same_v<std::remove_cvref_t<Arg>, std::allocator_arg_t> ||
+    (sizeof...(Args) == 0 && is_boxed<std::remove_cvref_t<Arg>>);
+
+
+/* Owning pointer to a single T allocated by Allocator, common part of box and recursive_wrapper.
+ * Nothing here is constrained on T, T only has to be complete where a member is used */
+template <typename T, typename Allocator>
+class heap_holder {
+  using traits = std::allocator_traits<Allocator>;
+
+  static_assert(std::is_same_v<typename traits::value_type, T>, "allocator of a boxed T must allocate T");
+  static_assert(std::is_object_v<T> && !std::is_array_v<T>, "boxed alternative is a single object");
+
+public:
+  using value_type = T;
+  using allocator_type = Allocator;
+  using pointer = typename traits::pointer;
+
+  template <typename... Args>
+  constexpr explicit heap_holder(std::in_place_t, Args&&... args)
+      : alloc(), ptr(make(std::forward<Args>(args)...))
+  {}
+
+  template <typename... Args>
+  constexpr heap_holder(std::allocator_arg_t, Allocator const& allocator, Args&&... args)
+      : alloc(allocator), ptr(make(std::forward<Args>(args)...))
+  {}
+
+  constexpr heap_holder(heap_holder const& other)
+      : alloc(traits::select_on_container_copy_construction(other.alloc)),
+        ptr(other.ptr != nullptr ? make(*other.ptr) : nullptr)
+  {}
+
+  constexpr heap_holder(heap_holder&& other) noexcept
+      : alloc(std::move(other.alloc)), ptr(std::exchange(other.ptr, nullptr))
+  {}
+
+  constexpr ~heap_holder() {
+    reset();
+  }
+
+  constexpr heap_holder& operator=(heap_holder const& other) {
+    if (this == &other) {
+      return *this;
+    }
+    if constexpr (traits::propagate_on_container_copy_assignment::value) {
+      if (alloc != other.alloc) {
+        reset();
+        alloc = other.alloc;
+      }
+    }
+    if (other.ptr == nullptr) {
+      reset();
+    } else {
+      *this = *other.ptr;
+    }
+    return *this;
+  }
+
+  /* Pointer is taken over when memory of other can be freed by this allocator, otherwise the value is moved */
+  constexpr heap_holder& operator=(heap_holder&& other)
+      noexcept(traits::propagate_on_container_move_assignment::value || traits::is_always_equal::value) {
+    if (this == &other) {
+      return *this;
+    }
+    if constexpr (traits::propagate_on_container_move_assignment::value) {
+      reset();
+      alloc = std::move(other.alloc);
+      ptr = std::exchange(other.ptr, nullptr);
+    } else if constexpr (traits::is_always_equal::value) {
+      reset();
+      ptr = std::exchange(other.ptr, nullptr);
+    } else if (alloc == other.alloc) {
+      reset();
+      ptr = std::exchange(other.ptr, nullptr);
+    } else if (other.ptr == nullptr) {
+      reset();
+    } else {
+      *this = std::move(*other.ptr);
+    }
+    return *this;
+  }
+
+  /* Assigns to the held value in place, so assignment of T to a variant holding a boxed T doesn't reallocate */
+  template <typename U>
+    requires(!is_boxed<std::remove_cvref_t<U>> &&
+             std::is_constructible_v<T, U> && std::is_assignable_v<T&, U>)
+  constexpr heap_holder& operator=(U&& value) {
+    if (ptr != nullptr) {
+      *ptr = std::forward<U>(value);
+    } else {
+      ptr = make(std::forward<U>(value));
+    }
+    return *this;
+  }
+
+  constexpr T& operator*() noexcept {
+    return *ptr;
+  }
+
+  constexpr T const& operator*() const noexcept {
+    return *ptr;
+  }
+
+  constexpr T* operator->() noexcept {
+    return std::to_address(ptr);
+  }
+
+  constexpr T const* operator->() const noexcept {
+    return std::to_address(ptr);
+  }
+
+  constexpr bool valueless_after_move() const noexcept {
+    return ptr == nullptr;
+  }
+
+  constexpr allocator_type get_allocator() const noexcept {
+    return alloc;
+  }
+
+  constexpr void swap(heap_holder& other) noexcept {
+    if constexpr (traits::propagate_on_container_swap::value) {
+      using std::swap;
+      swap(alloc, other.alloc);
+    }
+    std::swap(ptr, other.ptr);
+  }
+
+private:
+  template <typename... Args>
+  constexpr pointer make(Args&&... args) {
+    pointer p = traits::allocate(alloc, 1);
+    try {
+      traits::construct(alloc, std::to_address(p), std::forward<Args>(args)...);
+    } catch (...) {
+      traits::deallocate(alloc, p, 1);
+      throw;
+    }
+    return p;
+  }
+
+  constexpr void reset() noexcept {
+    if (ptr != nullptr) {
+      traits::destroy(alloc, std::to_address(ptr));
+      traits::deallocate(alloc, ptr, 1);
+      ptr = nullptr;
+    }
+  }
+
+  [[no_unique_address]] Allocator alloc;
+  pointer ptr;
+};
+
+}
+
+
+template <typename T, typename Allocator>
+class box : public variant_impl::heap_holder<T, Allocator> {
+  using base = variant_impl::heap_holder<T, Allocator>;
+
+public:
+  /* Implicit from a single argument T is implicitly constructible from,
+   * so the converting constructor of variant picks box<T> for a T */
+  template <typename... Args>
+    requires(std::is_constructible_v<T, Args...> &&
+             !variant_impl::reserved_box_arguments<Args...> &&
+             std::is_default_constructible_v<Allocator>)
+  constexpr explicit(sizeof...(Args) != 1 || !(std::is_convertible_v<Args, T> && ...)) box(Args&&... args)
+      : base(std::in_place, std::forward<Args>(args)...)
+  {}
+
+  template <typename... Args>
+    requires(std::is_constructible_v<T, Args...>)
+  constexpr box(std::allocator_arg_t, Allocator const& allocator, Args&&... args)
+      : base(std::allocator_arg, allocator, std::forward<Args>(args)...)
+  {}
+
+  constexpr box(box const&) requires(std::is_copy_constructible_v<T>) = default;
+  constexpr box(box&&) noexcept = default;
+
+  constexpr box& operator=(box const&) requires(std::is_copy_constructible_v<T> && std::is_copy_assignable_v<T>) = default;
+  constexpr box& operator=(box&&) = default;
+
+  using base::operator=;
+
+  friend constexpr void swap(box& lhs, box& rhs) noexcept {
+    lhs.swap(rhs);
+  }
+};
+
+
+template <typename T, typename Allocator>
+class recursive_wrapper : public variant_impl::heap_holder<T, Allocator> {
+  using base = variant_impl::heap_holder<T, Allocator>;
+
+public:
+  /* Constraints may not ask whether T is constructible: T usually holds a variant with this wrapper, whose
+   * converting constructor would ask it again. So only T itself converts implicitly, other arguments
+   * are checked when the constructor is instantiated */
+  template <typename... Args>
+    requires(!variant_impl::reserved_box_arguments<Args...> &&
+             std::is_default_constructible_v<Allocator>)
+  constexpr explicit(sizeof...(Args) != 1 || !(std::is_same_v<std::remove_cvref_t<Args>, T> && ...))
+  recursive_wrapper(Args&&... args)
+      : base(std::in_place, std::forward<Args>(args)...)
+  {}
+
+  template <typename... Args>
+  constexpr recursive_wrapper(std::allocator_arg_t, Allocator const& allocator, Args&&... args)
+      : base(std::allocator_arg, allocator, std::forward<Args>(args)...)
+  {}
+
+  constexpr recursive_wrapper(recursive_wrapper const&) = default;
+  constexpr recursive_wrapper(recursive_wrapper&&) noexcept = default;
+
+  constexpr recursive_wrapper& operator=(recursive_wrapper const&) = default;
+  constexpr recursive_wrapper& operator=(recursive_wrapper&&) = default;
+
+  using base::operator=;
+
+  friend constexpr void swap(recursive_wrapper& lhs, recursive_wrapper& rhs) noexcept {
+    lhs.swap(rhs);
+  }
+};
+
+
+namespace variant_impl {
+
+/* Alternative as seen by get and visit: the value of a box or recursive_wrapper or the object itself */
+template <typename T>
+constexpr auto& unbox(T& value) noexcept {
+  if constexpr (is_boxed<T>) {
+    return *value;
+  } else {
+    return value;
+  }
+}
+
+
+template <std::size_t Threshold, typename T>
+using boxed_if_larger_t = std::conditional_t<(sizeof(T) > Threshold) && !is_boxed<T> && !std::is_const_v<T>, box<T>, T>;
+
+}
+
+
+/* Policy form: alternatives larger than Threshold bytes are boxed with std::allocator,
+ * variant_boxed<16, int, std::array<char, 100>> is variant<int, box<std::array<char, 100>>> */
+template <std::size_t Threshold, typename... Types>
+using variant_boxed = variant<variant_impl::boxed_if_larger_t<Threshold, Types>...>;
@@ -2,73 +2,259 @@
 
 #include "variant-type-traits.h"
 #include "variant-helpers.h"
+#include "variant-never-valueless.h"
+#include "variant-niche.h"
 #include "variant-storage.h"
 
+#include <cstdint>
+#include <memory>
 #include <utility>
 
 
 namespace variant_impl {
 
+/* Keeps the index as a separate field next to the storage */
 template <typename... Types>
-struct variant_destructible_base {
+struct variant_layout {
+  using index_type = index_t<sizeof...(Types)>;
 
-  constexpr variant_destructible_base()
-      : holding_index(variant_npos)
+  constexpr variant_layout()
+      : holding_index(index_npos<index_type>)
   {}
 
   template <std::size_t Id, typename... Args>
-  constexpr explicit variant_destructible_base(
+  constexpr explicit variant_layout(
       in_place_index_t<Id>, Args&&... args) try
       : holding_index(Id),
         storage(in_place_index<Id>, std::forward<Args>(args)...)
   {} catch(...) {
-    holding_index = variant_npos;
+    holding_index = index_npos<index_type>;
     throw;
   }
 
-  constexpr ~variant_destructible_base() {
-    destroy();
+  constexpr std::size_t current_index() const noexcept {
+    return holding_index == index_npos<index_type> ? variant_npos : holding_index;
   }
 
-  constexpr void destroy() {
-    if (holding_index != variant_npos) {
-      internal_visit([]<typename T>(T const& val) { val.~T(); }, *this);
-      holding_index = variant_npos;
-    }
+  constexpr void set_index(std::size_t index) noexcept {
+    holding_index = (index == variant_npos ? index_npos<index_type> : static_cast<index_type>(index));
+  }
+
+  constexpr storage_t<Types...>& current_storage() noexcept {
+    return storage;
   }
 
-  std::size_t holding_index;
+  constexpr storage_t<Types...> const& current_storage() const noexcept {
+    return storage;
+  }
+
+  index_type holding_index;
   storage_t<Types...> storage;
 };
 
 
+/* Never valueless variant whose alternatives may throw while moved: new alternative is built
+ * in the spare storage, and only then the current one is destroyed and the storages switch roles */
 template <typename... Types>
-requires (TriviallyDestructible<Types...>)
-struct variant_destructible_base<Types...> {
+requires (DoubleBuffered<Types...>)
+struct variant_layout<Types...> {
+  using index_type = index_t<sizeof...(Types)>;
 
-  constexpr variant_destructible_base()
-      : holding_index(variant_npos)
+  constexpr variant_layout()
+      : holding_index(index_npos<index_type>)
   {}
 
   template <std::size_t Id, typename... Args>
-  constexpr explicit variant_destructible_base(
-      in_place_index_t<Id>, Args&&... args) try
+  constexpr explicit variant_layout(in_place_index_t<Id>, Args&&... args)
       : holding_index(Id),
-        storage(in_place_index<Id>, std::forward<Args>(args)...)
-  {} catch(...) {
-    holding_index = variant_npos;
-    throw;
+        storages{storage_t<Types...>(in_place_index<Id>, std::forward<Args>(args)...), storage_t<Types...>()}
+  {}
+
+  constexpr std::size_t current_index() const noexcept {
+    return holding_index == index_npos<index_type> ? variant_npos : holding_index;
   }
 
-  constexpr ~variant_destructible_base() = default;
+  constexpr void set_index(std::size_t index) noexcept {
+    holding_index = (index == variant_npos ? index_npos<index_type> : static_cast<index_type>(index));
+  }
 
-  constexpr void destroy() {
-    holding_index = variant_npos;
+  constexpr storage_t<Types...>& current_storage() noexcept {
+    return storages[current];
+  }
+
+  constexpr storage_t<Types...> const& current_storage() const noexcept {
+    return storages[current];
+  }
+
+  constexpr storage_t<Types...>& spare_storage() noexcept {
+    return storages[current ^ 1];
+  }
+
+  constexpr void switch_storage() noexcept {
+    current ^= 1;
+  }
+
+  index_type holding_index;
+  unsigned char current = 0;
+  storage_t<Types...> storages[2];
+};
+
+
+/* Keeps the index inside spare patterns of the niche alternative,
+ * so the variant takes exactly the storage */
+template <typename... Types>
+requires (has_niche<Types...> && !DoubleBuffered<Types...>)
+struct variant_layout<Types...> {
+  constexpr static std::size_t niche = niche_index<Types...>();
+  using niche_type = std::remove_cv_t<typename alternative_by_index<niche, Types...>::type>;
+  using traits = niche_traits<niche_type>;
+
+  constexpr variant_layout()
+      : storage() {
+    set_index(variant_npos);
+  }
+
+  template <std::size_t Id, typename... Args>
+  constexpr explicit variant_layout(in_place_index_t<Id>, Args&&... args)
+      : storage(in_place_index<Id>, std::forward<Args>(args)...) {
+    set_index(Id);
+  }
+
+  /* Pattern i stands for i-th alternative except the niche one, the last pattern - for valueless state */
+  constexpr std::size_t current_index() const noexcept {
+    std::size_t pattern = traits::get(std::addressof(storage));
+    if (pattern == traits::count) {
+      return niche;
+    }
+    if (pattern == sizeof...(Types) - 1) {
+      return variant_npos;
+    }
+    return pattern < niche ? pattern : pattern + 1;
+  }
+
+  /* Niche alternative is recognized by its value, so setting its index is no-op */
+  constexpr void set_index(std::size_t index) noexcept {
+    if (index == niche) {
+      return;
+    }
+    std::size_t pattern = (index == variant_npos ? sizeof...(Types) - 1 : (index < niche ? index : index - 1));
+    traits::set(std::addressof(storage), pattern);
+  }
+
+  constexpr storage_t<Types...>& current_storage() noexcept {
+    return storage;
+  }
+
+  constexpr storage_t<Types...> const& current_storage() const noexcept {
+    return storage;
   }
 
-  std::size_t holding_index;
   storage_t<Types...> storage;
 };
 
+
+/* Bit i is set if i-th alternative is trivially destructible, variants up to 64 alternatives use the mask */
+template <typename... Types>
+inline constexpr std::uint64_t trivially_destructible_mask = [] {
+  constexpr bool trivial[] = {std::is_trivially_destructible_v<Types>..., false};
+  std::uint64_t mask = 0;
+  for (std::size_t i = 0; i < sizeof...(Types) && i < 64; ++i) {
+    mask |= static_cast<std::uint64_t>(trivial[i]) << i;
+  }
+  return mask;
+}();
+
+template <typename... Types>
+constexpr bool trivially_destructible_at(std::size_t index) noexcept {
+  if constexpr (sizeof...(Types) <= 64) {
+    return (trivially_destructible_mask<Types...> & (std::uint64_t(1) << index)) != 0;
+  } else {
+    constexpr bool trivial[] = {std::is_trivially_destructible_v<Types>...};
+    return trivial[index];
+  }
+}
+
+
+template <typename... Types>
+struct variant_destructible_base : variant_layout<Types...> {
+  using variant_layout<Types...>::variant_layout;
+
+  constexpr ~variant_destructible_base() {
+    destroy();
+  }
+
+  /* Switch dispatch already folds the cases of trivially destructible alternatives into compares,
+   * table dispatch checks the mask first, so they cost no indirect call */
+  constexpr void destroy() {
+    std::size_t index = this->current_index();
+    if (index != variant_npos) {
+      if (sizeof...(Types) <= switch_dispatch_limit || !trivially_destructible_at<Types...>(index)) {
+        internal_visit([]<typename T>(T const& val) { val.~T(); }, *this);
+      }
+      this->set_index(variant_npos);
+    }
+  }
+};
+
+
+template <typename... Types>
+requires (TriviallyDestructible<Types...>)
+struct variant_destructible_base<Types...> : variant_layout<Types...> {
+  using variant_layout<Types...>::variant_layout;
+
+  constexpr ~variant_destructible_base() = default;
+
+  constexpr void destroy() {
+    this->set_index(variant_npos);
+  }
+};
+
+
+
+/* Destroys the current alternative, which must have index Id */
+template <std::size_t Id, typename... Types>
+constexpr void destroy_alternative(variant_destructible_base<Types...>& base) {
+  using T = std::remove_cv_t<typename alternative_by_index<Id, Types...>::type>;
+  if constexpr (!std::is_trivially_destructible_v<T>) {
+    get<Id>(base.current_storage()).~T();
+  }
+  base.set_index(variant_npos);
+}
+
+
+/* Destroys the current alternative and lets build(storage) construct the one with the given index.
+ * Nothrow tells that build never throws, Current is the index of the current alternative if it is known.
+ * If build throws, the variant is left valueless unless the never valueless policy is enabled,
+ * then it keeps the old alternative */
+template <bool Nothrow, std::size_t Current = variant_npos, typename... Types, typename Construct>
+constexpr void replace_alternative(variant_destructible_base<Types...>& base, std::size_t index,
+                                   Construct&& build) {
+  auto destroy_current = [&base] {
+    if constexpr (Current == variant_npos) {
+      base.destroy();
+    } else {
+      destroy_alternative<Current>(base);
+    }
+  };
+  if constexpr (DoubleBuffered<Types...>) {
+    std::forward<Construct>(build)(base.spare_storage());
+    destroy_current();
+    base.switch_storage();
+  } else if constexpr (NeverValueless<Types...> && !Nothrow) {
+    storage_t<Types...> aside;
+    std::forward<Construct>(build)(aside);
+    destroy_current();
+    dispatch<void, sizeof...(Types)>(index, [&](auto id) {
+      auto& alternative = get<id>(aside);
+      using T = std::remove_cvref_t<decltype(alternative)>;
+      construct<id>(base.current_storage(), std::move(alternative));
+      alternative.~T();
+    });
+  } else {
+    destroy_current();
+    std::forward<Construct>(build)(base.current_storage());
+  }
+  base.set_index(index);
 }
 
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "variant-helpers.h"
+#include "variant-type-traits.h"
+
+#include <concepts>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+
+
+namespace variant_impl {
+
+template <typename T>
+concept Hashable = requires(T const& t) {
+  { std::hash<std::remove_const_t<T>>{}(t) } -> std::convertible_to<std::size_t>;
+};
+
+/* Values that fit into size_t are mixed in as they are, without a call to std::hash */
+template <typename T>
+concept TriviallyHashable =
+    (std::is_integral_v<T> || std::is_enum_v<T> || std::is_pointer_v<T>) && sizeof(T) <= sizeof(std::size_t);
+
+/* Single multiply-xorshift round: index is added with an odd multiplier so that equal values
+ * of different alternatives are spread apart, high bits of the product are folded into the low ones */
+inline std::size_t hash_mix(std::size_t index, std::size_t value) noexcept {
+  std::uint64_t h = (static_cast<std::uint64_t>(value) + static_cast<std::uint64_t>(index) * 0x9e3779b97f4a7c15ULL) *
+                    0xbf58476d1ce4e5b9ULL;
+  return static_cast<std::size_t>(h ^ (h >> 32));
+}
+
+template <typename T>
+std::size_t hash_alternative(std::size_t index, T const& value) {
+  using value_t = std::remove_const_t<T>;
+  if constexpr (std::is_pointer_v<value_t>) {
+    return hash_mix(index, reinterpret_cast<std::uintptr_t>(value));
+  } else if constexpr (std::is_enum_v<value_t>) {
+    return hash_mix(index, static_cast<std::size_t>(static_cast<std::underlying_type_t<value_t>>(value)));
+  } else if constexpr (TriviallyHashable<value_t>) {
+    return hash_mix(index, static_cast<std::size_t>(value));
+  } else {
+    return hash_mix(index, std::hash<value_t>{}(value));
+  }
+}
+
+/* Hash of the valueless variant, any value that is unlikely for a holding one */
+inline constexpr std::size_t valueless_hash = static_cast<std::size_t>(0x5bd1e9955bd1e995ULL);
+
+}
+
+
+template <typename... Types>
+  requires(variant_impl::Hashable<variant_impl::unboxed_t<Types>> && ...)
+struct std::hash<::variant<Types...>> {
+  std::size_t operator()(::variant<Types...> const& v) const {
+    if (v.valueless_by_exception()) {
+      return variant_impl::valueless_hash;
+    }
+    return variant_impl::dispatch<std::size_t, sizeof...(Types)>(v.index(), [&](auto id) {
+      return variant_impl::hash_alternative(id, variant_impl::unbox(get<id>(v.current_storage())));
+    });
+  }
+};
+
+
+/* Transparent hasher and equality for unordered containers keyed by variant:
+ * find(t) with a value of an alternative that occurs once does not construct a variant key.
+ * Hash of t equals the hash of a variant holding t */
+template <typename Variant>
+struct variant_hash;
+
+template <typename... Types>
+  requires(variant_impl::Hashable<variant_impl::unboxed_t<Types>> && ...)
+struct variant_hash<variant<Types...>> {
+  using is_transparent = void;
+
+  std::size_t operator()(variant<Types...> const& v) const {
+    return std::hash<variant<Types...>>{}(v);
+  }
+
+  template <typename T>
+    requires(UniqueEntry<T, Types...>)
+  std::size_t operator()(T const& t) const {
+    return variant_impl::hash_alternative(variant_impl::index_by_type<T, 0, Types...>::index, t);
+  }
+};
+
+
+template <typename Variant>
+struct variant_equal_to;
+
+template <typename... Types>
+struct variant_equal_to<variant<Types...>> {
+  using is_transparent = void;
+
+  constexpr bool operator()(variant<Types...> const& v, variant<Types...> const& w) const {
+    return v == w;
+  }
+
+  template <typename T>
+    requires(UniqueEntry<T, Types...>)
+  constexpr bool operator()(variant<Types...> const& v, T const& t) const {
+    return v == t;
+  }
+
+  template <typename T>
+    requires(UniqueEntry<T, Types...>)
+  constexpr bool operator()(T const& t, variant<Types...> const& w) const {
+    return w == t;
+  }
+};
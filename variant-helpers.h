@@ -3,7 +3,10 @@
 #include "variant-type-traits.h"
 
 #include <array>
+#include <exception>
 #include <limits>
+#include <stdexcept>
+#include <string>
 #include <tuple>
 
 
@@ -32,11 +35,21 @@ template <std::size_t Id, typename... Types>
 constexpr const variant_alternative_t<Id, variant<Types...>>&&
 get(const variant<Types...>&& v);
 
-template <typename Visitor, typename... Variants>
-constexpr decltype(auto) visit(Visitor&&, Variants&&...);
+template <std::size_t Id, typename... Types>
+constexpr variant_alternative_t<Id, variant<Types...>>&
+get_unchecked(variant<Types...>& v) noexcept;
 
-template <typename R, typename Visitor, typename... Variants>
-constexpr R visit(Visitor&&, Variants&&...);
+template <std::size_t Id, typename... Types>
+constexpr variant_alternative_t<Id, variant<Types...>>&&
+get_unchecked(variant<Types...>&& v) noexcept;
+
+template <std::size_t Id, typename... Types>
+constexpr const variant_alternative_t<Id, variant<Types...>>&
+get_unchecked(const variant<Types...>& v) noexcept;
+
+template <std::size_t Id, typename... Types>
+constexpr const variant_alternative_t<Id, variant<Types...>>&&
+get_unchecked(const variant<Types...>&& v) noexcept;
 
 template <typename T, typename... Types>
 constexpr bool holds_alternative(variant<Types...> const& v) noexcept;
@@ -65,27 +78,87 @@ inline constexpr std::size_t variant_npos = std::numeric_limits<std::size_t>::ma
 
 namespace variant_impl {
 
-template<std::size_t Id, typename T, typename... TRest>
-requires (InBound<Id, T, TRest...>)
+/* Smallest unsigned type holding every index of Count alternatives
+ * and the valueless sentinel, which is the maximum of the type */
+template <std::size_t Count>
+using index_t = std::conditional_t<(Count <= std::numeric_limits<unsigned char>::max() - 1), unsigned char,
+                std::conditional_t<(Count <= std::numeric_limits<unsigned short>::max() - 1), unsigned short,
+                std::conditional_t<(Count <= std::numeric_limits<unsigned int>::max() - 1), unsigned int,
+                                   std::size_t>>>;
+
+template <typename Index>
+inline constexpr Index index_npos = std::numeric_limits<Index>::max();
+
+}
+
+
+namespace variant_impl {
+
+template <std::size_t Id, typename T>
+struct indexed_type {
+  using type = T;
+};
+
+template <typename Ids, typename... Types>
+struct indexed_types;
+
+template <std::size_t... Ids, typename... Types>
+struct indexed_types<std::index_sequence<Ids...>, Types...> : indexed_type<Ids, Types>... {};
+
+template <std::size_t Id, typename T>
+indexed_type<Id, T> select_indexed(indexed_type<Id, T> const&);
+
+
+#if defined(__has_builtin)
+#if __has_builtin(__type_pack_element)
+#define VARIANT_HAS_TYPE_PACK_ELEMENT
+#endif
+#endif
+
+/* Both lookups have constant instantiation depth: alternative is taken by the compiler builtin
+ * or found by overload resolution among indexed bases, index is found by a constexpr loop.
+ * The call is qualified: argument dependent lookup would instantiate templates named by the alternatives,
+ * and a recursive alternative may still be incomplete */
+template <std::size_t Id, typename... Types>
+requires (InBound<Id, Types...>)
 struct alternative_by_index {
-  using type = typename alternative_by_index<Id - 1, TRest...>::type;
+#ifdef VARIANT_HAS_TYPE_PACK_ELEMENT
+  using type = __type_pack_element<Id, Types...>;
+#else
+  using type = typename decltype(variant_impl::select_indexed<Id>(
+      std::declval<indexed_types<std::index_sequence_for<Types...>, Types...> const&>()))::type;
+#endif
 };
 
-template<typename T, typename... TRest>
-struct alternative_by_index<0, T, TRest...> {
-  using type = T;
+#undef VARIANT_HAS_TYPE_PACK_ELEMENT
+
+
+/* Template<Types[Offset], ..., Types[Offset + sizeof...(Ids) - 1]>,
+ * every type is found by overload resolution, so the depth doesn't grow with the number of types */
+template <template <typename...> typename Template, std::size_t Offset, typename Ids, typename... Types>
+struct slice_types;
+
+template <template <typename...> typename Template, std::size_t Offset, std::size_t... Ids, typename... Types>
+struct slice_types<Template, Offset, std::index_sequence<Ids...>, Types...> {
+  using pack = indexed_types<std::index_sequence_for<Types...>, Types...>;
+  using type =
+      Template<typename decltype(variant_impl::select_indexed<Offset + Ids>(std::declval<pack const&>()))::type...>;
 };
 
 
-template<typename S, std::size_t Id, typename T, typename... TRest>
+template <typename S, std::size_t Id, typename... Types>
 struct index_by_type {
-  static constexpr std::size_t index = (std::is_same_v<S, T> ?
-      Id : index_by_type<S, Id + 1, TRest...>::index);
-};
+  constexpr static std::size_t find() {
+    constexpr bool matches[] = {(std::is_same_v<S, Types> || std::is_same_v<S, unboxed_t<Types>>)..., false};
+    for (std::size_t i = 0; i < sizeof...(Types); ++i) {
+      if (matches[i]) {
+        return Id + i;
+      }
+    }
+    return variant_npos;
+  }
 
-template<typename S, std::size_t Id, typename T>
-struct index_by_type<S, Id, T> {
-  static constexpr std::size_t index = (std::is_same_v<S, T> ? Id : variant_npos);
+  static constexpr std::size_t index = find();
 };
 
 
@@ -100,6 +173,18 @@ struct is_in_place_index_t_specialization<in_place_index_t<Id>> {
 };
 
 
+/* Access to the private constructor of a valueless variant, for library code that builds the alternative
+ * in its storage right after. Nothing else can break the never valueless policy with it */
+struct valueless_construct_t {
+  explicit valueless_construct_t() = default;
+
+  template <typename Variant>
+  static constexpr Variant make() noexcept {
+    return Variant(valueless_construct_t());
+  }
+};
+
+
 template <typename T>
 struct is_variant_specialization {
   constexpr static bool value = false;
@@ -110,6 +195,22 @@ struct is_variant_specialization<variant<Types...>> {
   constexpr static bool value = true;
 };
 
+}
+
+
+/* Declarations must carry the constraints of the definitions,
+ * otherwise they are distinct overloads that also match std::variant */
+template <typename Visitor, typename... Variants>
+constexpr decltype(auto) visit(Visitor&&, Variants&&...)
+    requires(variant_impl::is_variant_specialization<std::remove_cvref_t<Variants>>::value && ...);
+
+template <typename R, typename Visitor, typename... Variants>
+constexpr R visit(Visitor&&, Variants&&...)
+    requires(variant_impl::is_variant_specialization<std::remove_cvref_t<Variants>>::value && ...);
+
+
+namespace variant_impl {
+
 
 template <typename... Types>
 union storage_t;
@@ -154,7 +255,7 @@ inline constexpr std::size_t variant_size_v = variant_size<T>::value;
 
 template <std::size_t Id, typename... Types>
 struct variant_alternative<Id, variant<Types...>> {
-  using type = typename variant_impl::alternative_by_index<Id, Types...>::type;
+  using type = variant_impl::unboxed_t<typename variant_impl::alternative_by_index<Id, Types...>::type>;
 };
 
 template <std::size_t Id, typename T>
@@ -169,80 +270,172 @@ template <typename... Types>
 struct variant_destructible_base;
 
 
-template <typename Func, std::size_t... SizeRest>
-struct multidimensional_table {
-  template <typename... IndexRest>
-  constexpr Func get_function_ptr(IndexRest... index_rest) const {
-    return storage;
-  }
-  Func storage;
-};
+[[noreturn]] inline void unreachable() {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_unreachable();
+#elif defined(_MSC_VER)
+  __assume(false);
+#else
+  std::terminate();
+#endif
+}
 
 
-template <typename Func, std::size_t Size0, std::size_t... SizeRest>
-struct multidimensional_table<Func, Size0, SizeRest...> {
-  template <typename Index0, typename... IndexRest>
-  constexpr Func get_function_ptr(Index0 index0, IndexRest... index_rest) const {
-    return storage[index0].get_function_ptr(index_rest...);
-  }
-  std::array<multidimensional_table<Func, SizeRest...>, Size0> storage;
-};
+/* Sizes up to this one are dispatched by switch, bigger ones - by table of function pointers */
+inline constexpr std::size_t switch_dispatch_limit = 32;
 
 
-template <typename Func, typename SizesWrapper, typename CapturedIndexesWrapper>
-struct table_builder;
+template <typename R, typename Func, std::size_t Id>
+constexpr R dispatch_cell(Func&& func) {
+  return std::forward<Func>(func)(std::integral_constant<std::size_t, Id>{});
+}
 
+template <typename R, typename Func, std::size_t... Ids>
+constexpr R table_dispatch(std::size_t index, Func&& func, std::index_sequence<Ids...>) {
+  constexpr R (*table[])(Func&&) = {&dispatch_cell<R, Func, Ids>...};
+  return table[index](std::forward<Func>(func));
+}
 
-template <typename R, typename Visitor, typename... Objects,
-          std::size_t... SizeRest, std::size_t... CapturedIndexes>
-struct table_builder<R (*)(Visitor, Objects...),
-                     std::index_sequence<SizeRest...>,
-                     std::index_sequence<CapturedIndexes...>> {
+#define VARIANT_DISPATCH_CASE(Id)                                                   \
+  case Id:                                                                          \
+    if constexpr (Id < Size) {                                                      \
+      return std::forward<Func>(func)(std::integral_constant<std::size_t, Id>{});  \
+    } else {                                                                        \
+      unreachable();                                                                \
+    }
+
+#define VARIANT_DISPATCH_CASES_4(Base)                                              \
+  VARIANT_DISPATCH_CASE(Base) VARIANT_DISPATCH_CASE(Base + 1)                       \
+  VARIANT_DISPATCH_CASE(Base + 2) VARIANT_DISPATCH_CASE(Base + 3)
+
+#define VARIANT_DISPATCH_CASES_8(Base)                                              \
+  VARIANT_DISPATCH_CASES_4(Base) VARIANT_DISPATCH_CASES_4(Base + 4)
+
+/* Number of cases is rounded up to 4, 8, 16 or 32, so small variants don't pay for the biggest switch */
+template <typename R, std::size_t Size, typename Func>
+constexpr R switch_dispatch(std::size_t index, Func&& func) {
+  if constexpr (Size <= 4) {
+    switch (index) {
+      VARIANT_DISPATCH_CASES_4(0)
+    default:
+      unreachable();
+    }
+  } else if constexpr (Size <= 8) {
+    switch (index) {
+      VARIANT_DISPATCH_CASES_8(0)
+    default:
+      unreachable();
+    }
+  } else if constexpr (Size <= 16) {
+    switch (index) {
+      VARIANT_DISPATCH_CASES_8(0) VARIANT_DISPATCH_CASES_8(8)
+    default:
+      unreachable();
+    }
+  } else {
+    switch (index) {
+      VARIANT_DISPATCH_CASES_8(0) VARIANT_DISPATCH_CASES_8(8) VARIANT_DISPATCH_CASES_8(16) VARIANT_DISPATCH_CASES_8(24)
+    default:
+      unreachable();
+    }
+  }
+}
 
-  constexpr static decltype(auto) invoker(Visitor&& vis, Objects&&... vars) {
-    return std::forward<Visitor>(vis)(get<CapturedIndexes>(std::forward<Objects>(vars))...);
+#undef VARIANT_DISPATCH_CASES_8
+#undef VARIANT_DISPATCH_CASES_4
+#undef VARIANT_DISPATCH_CASE
+
+static_assert(switch_dispatch_limit == 32, "switch_dispatch must have a case for every index below the limit");
+
+
+/* Calls func(std::integral_constant<std::size_t, index>{}) for index < Size.
+ * Small sizes are lowered to a jump table with every case inlined */
+template <typename R, std::size_t Size, typename Func>
+constexpr R dispatch(std::size_t index, Func&& func) {
+  if constexpr (Size <= switch_dispatch_limit) {
+    return switch_dispatch<R, Size>(index, std::forward<Func>(func));
+  } else {
+    return table_dispatch<R>(index, std::forward<Func>(func), std::make_index_sequence<Size>());
   }
+}
+
 
-  constexpr static decltype(auto) init_level() {
-    return multidimensional_table<R (*)(Visitor&&, Objects&&...)>{&invoker};
+/* Alternative of the variant or its storage with value category of the variant, boxed one is unwrapped.
+ * Index is not checked */
+template <std::size_t Id, typename Variant>
+constexpr decltype(auto) alternative(Variant&& var) {
+  if constexpr (std::is_lvalue_reference_v<Variant>) {
+    return unbox(get<Id>(var.current_storage()));
+  } else {
+    return std::move(unbox(get<Id>(var.current_storage())));
   }
+}
+
+
+template <std::size_t Position, typename Variant>
+struct variant_ref {
+  Variant&& var;
 };
 
+template <typename Positions, typename... Variants>
+struct variant_refs;
 
-template <typename R, typename Visitor, typename... Objects,
-          std::size_t Size0, std::size_t... SizeRest, std::size_t... CapturedIndexes>
-struct table_builder<R (*)(Visitor, Objects...),
-                     std::index_sequence<Size0, SizeRest...>,
-                     std::index_sequence<CapturedIndexes...>> {
-
-  template <std::size_t... LevelIndexes>
-  constexpr static decltype(auto) init_cell(std::index_sequence<LevelIndexes...>) {
-    multidimensional_table<R (*)(Visitor&&, Objects&&...),
-                           Size0,
-                           SizeRest...> table;
-    ((table.storage[LevelIndexes] =
-          table_builder<R (*)(Visitor, Objects...),
-          std::index_sequence<SizeRest...>,
-          std::index_sequence<CapturedIndexes..., LevelIndexes>>
-      ::init_level()), ...);
-    return table;
+template <std::size_t... Positions, typename... Variants>
+struct variant_refs<std::index_sequence<Positions...>, Variants...> : variant_ref<Positions, Variants>... {
+  constexpr static std::size_t count = sizeof...(Variants);
+};
+
+template <std::size_t Position, typename Variant>
+constexpr Variant&& get_ref(variant_ref<Position, Variant> const& ref) {
+  return std::forward<Variant>(ref.var);
+}
+
+
+/* Variants are dispatched one at a time: every level binds index of one more variant,
+ * so there is no table of all index combinations and the visitor may be inlined into every case.
+ * Level object itself is the dispatch callback, so every index combination costs a single function */
+template <typename R, typename Visitor, typename Refs, typename BoundIndexes, typename BoundPositions>
+struct level_invoker;
+
+template <typename R, typename Visitor, typename Refs, std::size_t... BoundIndexes, std::size_t... BoundPositions>
+struct level_invoker<R, Visitor, Refs, std::index_sequence<BoundIndexes...>, std::index_sequence<BoundPositions...>> {
+  constexpr static std::size_t level = sizeof...(BoundIndexes);
+
+  constexpr R invoke() const {
+    using current = std::remove_reference_t<decltype(get_ref<level>(refs))>;
+    return dispatch<R, variant_size_v<current>>(get_ref<level>(refs).index(), *this);
   }
 
-  constexpr static decltype(auto) init_level() {
-    return init_cell(std::make_index_sequence<Size0>());
+  template <std::size_t Id>
+  constexpr R operator()(std::integral_constant<std::size_t, Id>) const {
+    if constexpr (level + 1 < Refs::count) {
+      return level_invoker<R, Visitor, Refs,
+                           std::index_sequence<BoundIndexes..., Id>,
+                           std::index_sequence<BoundPositions..., level>>{std::forward<Visitor>(vis), refs}
+          .invoke();
+    } else if constexpr (std::is_void_v<R>) {
+      std::forward<Visitor>(vis)(alternative<BoundIndexes>(get_ref<BoundPositions>(refs))...,
+                                 alternative<Id>(get_ref<level>(refs)));
+    } else {
+      return std::forward<Visitor>(vis)(alternative<BoundIndexes>(get_ref<BoundPositions>(refs))...,
+                                        alternative<Id>(get_ref<level>(refs)));
+    }
   }
+
+  Visitor&& vis;
+  Refs const& refs;
 };
 
 
 template <typename R, typename Visitor, typename... Variants>
 struct invoker {
-  constexpr static decltype(auto) invoke(Visitor&& vis, Variants&&... vars) {
-    return (*working_table.get_function_ptr(vars.index()...))
-        (std::forward<Visitor>(vis), std::forward<Variants>(vars)...);
+  using refs_t = variant_refs<std::index_sequence_for<Variants...>, Variants...>;
+
+  constexpr static R invoke(Visitor&& vis, Variants&&... vars) {
+    refs_t const refs{{std::forward<Variants>(vars)}...};
+    return level_invoker<R, Visitor, refs_t, std::index_sequence<>, std::index_sequence<>>{
+        std::forward<Visitor>(vis), refs}.invoke();
   }
-  constexpr static auto working_table = table_builder<R (*)(Visitor&&, Variants&&...),
-                                                      std::index_sequence<variant_size_v<std::remove_reference_t<Variants>>...>,
-                                                      std::index_sequence<>>::init_level();
 };
 
 
@@ -285,35 +478,31 @@ struct take_storage_t<const variant_destructible_base<Types...>> {
 };
 
 
-template <typename Visitor, typename... Variants>
-struct internal_invoker {
-  constexpr static decltype(auto) take_last(Variants&&... vars) {
-    return (std::forward<Variants>(vars), ...);
-  }
+/* Dispatches over storage of a variant or of its base, valueless one must not be passed */
+template <typename Visitor, typename Variant>
+constexpr void internal_visit(Visitor&& vis, Variant&& var) {
+  dispatch<void, storage_size_v<typename take_storage_t<std::remove_reference_t<Variant>>::type>>(
+      var.current_index(), [&](auto id) {
+        std::forward<Visitor>(vis)(get<id>(var.current_storage()));
+      });
+}
 
-  template <typename T>
-  constexpr static std::size_t get_or_default(T&& var, std::size_t def) {
-    return var.holding_index == variant_npos ? def : var.holding_index;
-  }
 
-  /* Last item in vars... must hold some index -
-   * it's called default and applied for every non-holding item in vars... */
-  constexpr static decltype(auto) invoke(Visitor&& vis, Variants&&... vars) {
-    std::size_t def = take_last(std::forward<Variants>(vars)...).holding_index;
-    return (*working_table.get_function_ptr(get_or_default(std::forward<Variants>(vars), def)...))
-        (std::forward<Visitor>(vis), std::forward<typename take_storage_t<std::remove_reference_t<Variants>>::type>(std::forward<Variants>(vars).storage)...);
-  }
-  constexpr static auto working_table = table_builder<void (*)(Visitor&&, typename take_storage_t<std::remove_reference_t<Variants>>::type&&...),
-                                                      std::index_sequence<storage_size_v<std::remove_reference_t<decltype(std::remove_reference_t<Variants>::storage)>>...>,
-                                                      std::index_sequence<>>::init_level();
-};
+/* Calls vis with the same alternative of both variants, index is taken from rhs which must not be valueless.
+ * Only N pairs are instantiated instead of N^2 */
+template <typename R = void, typename Visitor, typename Lhs, typename Rhs>
+constexpr R same_index_visit(Visitor&& vis, Lhs&& lhs, Rhs&& rhs) {
+  return dispatch<R, storage_size_v<typename take_storage_t<std::remove_reference_t<Rhs>>::type>>(
+      rhs.current_index(), [&](auto id) -> R {
+        return std::forward<Visitor>(vis)(get<id>(lhs.current_storage()), get<id>(rhs.current_storage()));
+      });
+}
 
 
-template <typename Visitor, typename... Variants>
-constexpr void internal_visit(Visitor&& vis, Variants&&... vars)  {
-  return variant_impl::internal_invoker<Visitor, Variants...>
-      ::invoke(std::forward<Visitor>(vis), std::forward<Variants>(vars)...);
+/* Index shifted by one, so valueless variant gets 0 and compares less than any holding one */
+template <typename Variant>
+constexpr std::size_t ordering_index(Variant const& var) noexcept {
+  return var.index() + 1;
 }
 
 }
-
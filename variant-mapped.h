@@ -0,0 +1,264 @@
+#pragma once
+
+#include "variant.h"
+#include "variant-serialize.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <string>
+#include <system_error>
+#include <utility>
+#define VARIANT_HAS_MMAP
+#endif
+
+
+/* On-disk layout of an array of variants read by mapped_variant_span. It doesn't depend on the layout of
+ * variant in memory or on the number of alternatives, only on the alternatives themselves:
+ *   header   fingerprint (uint32), record_size (uint32), zero padding up to data_offset,
+ *   record   tag (uint32) at offset 0, payload at payload_offset, zero padding up to record_size.
+ * Every record starts at a multiple of alignment, so payloads are read in place from a page aligned mapping */
+template <typename... Types>
+struct mapped_variant_layout {
+  static_assert(sizeof...(Types) > 0, "mapped variant needs at least one alternative");
+  static_assert((variant_impl::RawSerializable<Types> && ...),
+                "mapped alternatives must be trivially copyable and must not be pointers");
+  static_assert(((!std::is_const_v<Types> && !std::is_volatile_v<Types>) && ...),
+                "mapped alternatives are read through const views, they must not be cv-qualified");
+
+  using tag_type = std::uint32_t;
+
+  static constexpr std::size_t alignment = std::max({alignof(tag_type), alignof(Types)...});
+  static constexpr std::size_t payload_offset = std::max({sizeof(tag_type), alignof(Types)...});
+  static constexpr std::size_t record_size =
+      (payload_offset + std::max({sizeof(Types)...}) + alignment - 1) / alignment * alignment;
+  static constexpr std::size_t header_size = 2 * sizeof(std::uint32_t);
+  static constexpr std::size_t data_offset = (header_size + alignment - 1) / alignment * alignment;
+  static constexpr std::uint32_t fingerprint = variant_fingerprint_v<variant<Types...>>;
+
+  static_assert(alignment <= 4096, "records must stay aligned in a page aligned mapping");
+  static_assert(payload_offset % std::max({alignof(Types)...}) == 0);
+  static_assert(record_size % alignment == 0 && data_offset % alignment == 0);
+};
+
+
+/* Read-only view of an array of trivially copyable variants in the mapped layout, usually a memory mapped file.
+ * Header, every tag and every bool or niche payload are checked once by the constructor, after that visit
+ * and get_if read the alternatives in place, nothing is copied or parsed. The bytes must outlive the view */
+template <typename... Types>
+class mapped_variant_span {
+public:
+  using layout = mapped_variant_layout<Types...>;
+  using tag_type = typename layout::tag_type;
+
+  /* Throws bad_variant_encoding if bytes were written for other alternatives, are truncated, misaligned
+   * or hold a tag out of range or a payload that is not a value of its alternative */
+  explicit mapped_variant_span(std::span<std::byte const> bytes)
+      : data(bytes.data()) {
+    if (bytes.size() < layout::data_offset) {
+      throw bad_variant_encoding("truncated header");
+    }
+    if (reinterpret_cast<std::uintptr_t>(bytes.data()) % layout::alignment != 0) {
+      throw bad_variant_encoding("misaligned records");
+    }
+    std::uint32_t header[2];
+    std::memcpy(header, bytes.data(), sizeof(header));
+    if (header[0] != layout::fingerprint || header[1] != layout::record_size) {
+      throw bad_variant_encoding("fingerprint mismatch");
+    }
+    std::size_t records = bytes.size() - layout::data_offset;
+    if (records % layout::record_size != 0) {
+      throw bad_variant_encoding("truncated record");
+    }
+    length = records / layout::record_size;
+    data += layout::data_offset;
+    /* Branchless maximum over all tags, a single comparison at the end */
+    tag_type largest = 0;
+    for (std::size_t i = 0; i < length; ++i) {
+      largest = std::max(largest, tag_at(i));
+    }
+    if (length != 0 && largest >= sizeof...(Types)) {
+      throw bad_variant_encoding("invalid index");
+    }
+    /* Payloads are read in place, so a bool or niche alternative must hold one of its values */
+    if constexpr ((variant_impl::has_invalid_bytes<Types> || ...)) {
+      for (std::size_t i = 0; i < length; ++i) {
+        bool valid = variant_impl::dispatch<bool, sizeof...(Types)>(tag_at(i), [&](auto id) {
+          using T = variant_alternative_t<id, variant<Types...>>;
+          return variant_impl::valid_object_bytes<T>(record(i) + layout::payload_offset);
+        });
+        if (!valid) {
+          throw bad_variant_encoding("invalid value of alternative");
+        }
+      }
+    }
+  }
+
+  std::size_t size() const noexcept {
+    return length;
+  }
+
+  bool empty() const noexcept {
+    return length == 0;
+  }
+
+  std::size_t index(std::size_t pos) const noexcept {
+    return tag_at(pos);
+  }
+
+  template <std::size_t Id>
+    requires(InBound<Id, Types...>)
+  variant_alternative_t<Id, variant<Types...>> const* get_if(std::size_t pos) const noexcept {
+    return index(pos) == Id ? std::addressof(alternative<Id>(pos)) : nullptr;
+  }
+
+  template <typename T>
+    requires(UniqueEntry<T, Types...>)
+  T const* get_if(std::size_t pos) const noexcept {
+    return get_if<variant_impl::index_by_type<T, 0, Types...>::index>(pos);
+  }
+
+  template <typename Visitor>
+  decltype(auto) visit(std::size_t pos, Visitor&& vis) const {
+    using first_t = variant_alternative_t<0, variant<Types...>>;
+    using result_t = decltype(std::forward<Visitor>(vis)(std::declval<first_t const&>()));
+    return variant_impl::dispatch<result_t, sizeof...(Types)>(index(pos), [&](auto id) -> result_t {
+      return std::forward<Visitor>(vis)(alternative<id>(pos));
+    });
+  }
+
+  /* Calls vis with every record in order */
+  template <typename Visitor>
+  void visit_each(Visitor&& vis) const {
+    for (std::size_t i = 0; i < length; ++i) {
+      variant_impl::dispatch<void, sizeof...(Types)>(tag_at(i), [&](auto id) {
+        vis(alternative<id>(i));
+      });
+    }
+  }
+
+  variant<Types...> operator[](std::size_t pos) const {
+    return variant_impl::dispatch<variant<Types...>, sizeof...(Types)>(index(pos), [&](auto id) {
+      return variant<Types...>(in_place_index<id>, alternative<id>(pos));
+    });
+  }
+
+  /* Header and records of items in the mapped layout, ready to be written to a file.
+   * Throws bad_variant_access if an item is valueless */
+  static std::vector<std::byte> image(std::span<variant<Types...> const> items) {
+    std::vector<std::byte> bytes(layout::data_offset + items.size() * layout::record_size);
+    std::uint32_t header[2] = {layout::fingerprint, static_cast<std::uint32_t>(layout::record_size)};
+    std::memcpy(bytes.data(), header, sizeof(header));
+    std::byte* out = bytes.data() + layout::data_offset;
+    for (variant<Types...> const& v : items) {
+      if (v.valueless_by_exception()) {
+        throw bad_variant_access("valueless variant has no mapped record");
+      }
+      tag_type tag = static_cast<tag_type>(v.index());
+      std::memcpy(out, &tag, sizeof(tag));
+      variant_impl::dispatch<void, sizeof...(Types)>(v.index(), [&](auto id) {
+        auto const& value = get<id>(v);
+        std::memcpy(out + layout::payload_offset, std::addressof(value), sizeof(value));
+      });
+      out += layout::record_size;
+    }
+    return bytes;
+  }
+
+private:
+  std::byte const* record(std::size_t pos) const noexcept {
+    return data + pos * layout::record_size;
+  }
+
+  tag_type tag_at(std::size_t pos) const noexcept {
+    return *std::launder(reinterpret_cast<tag_type const*>(record(pos)));
+  }
+
+  template <std::size_t Id>
+  variant_alternative_t<Id, variant<Types...>> const& alternative(std::size_t pos) const noexcept {
+    using T = variant_alternative_t<Id, variant<Types...>>;
+    return *std::launder(reinterpret_cast<T const*>(record(pos) + layout::payload_offset));
+  }
+
+  std::byte const* data;
+  std::size_t length = 0;
+};
+
+
+#ifdef VARIANT_HAS_MMAP
+
+/* Read-only private mapping of a whole file, unmapped by the destructor */
+class mapped_file {
+public:
+  /* Throws std::system_error if the file can't be opened or mapped */
+  explicit mapped_file(std::string const& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), "open " + path);
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+      int error = errno;
+      ::close(fd);
+      throw std::system_error(error, std::generic_category(), "stat " + path);
+    }
+    length = static_cast<std::size_t>(info.st_size);
+    if (length != 0) {
+      void* mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapping == MAP_FAILED) {
+        int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "mmap " + path);
+      }
+      address = static_cast<std::byte const*>(mapping);
+    }
+    ::close(fd);
+  }
+
+  mapped_file(mapped_file&& other) noexcept
+      : address(std::exchange(other.address, nullptr)), length(std::exchange(other.length, 0)) {}
+
+  mapped_file& operator=(mapped_file&& other) noexcept {
+    if (this != &other) {
+      unmap();
+      address = std::exchange(other.address, nullptr);
+      length = std::exchange(other.length, 0);
+    }
+    return *this;
+  }
+
+  ~mapped_file() {
+    unmap();
+  }
+
+  std::span<std::byte const> bytes() const noexcept {
+    return {address, length};
+  }
+
+private:
+  void unmap() noexcept {
+    if (address != nullptr) {
+      ::munmap(const_cast<std::byte*>(address), length);
+    }
+  }
+
+  std::byte const* address = nullptr;
+  std::size_t length = 0;
+};
+
+#endif
+
+#undef VARIANT_HAS_MMAP
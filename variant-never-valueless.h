@@ -0,0 +1,22 @@
+#pragma once
+
+#include "variant-type-traits.h"
+
+
+/* Opt-in policy: variant<Types...> with this set to true never becomes valueless.
+ * Alternative that may throw while constructed is built aside and moved in,
+ * if some alternative may also throw while moved, the variant keeps a second storage to build it in.
+ * valueless_by_exception() is then false at compile time, so visit and comparisons drop the valueless checks */
+template <typename... Types>
+inline constexpr bool enable_never_valueless = false;
+
+
+namespace variant_impl {
+
+template <typename... Types>
+concept NeverValueless = enable_never_valueless<Types...>;
+
+template <typename... Types>
+concept DoubleBuffered = NeverValueless<Types...> && !NothrowMoveConstructible<Types...>;
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+
+/* Opt-in description of bit patterns that never represent a valid value of T.
+ * A specialization provides:
+ *   count        - number of spare patterns,
+ *   set(p, i)    - writes i-th spare pattern (i < count) into storage of T at p,
+ *   get(p)       - number of the spare pattern stored at p or count if p holds a value of T.
+ * Variant with such an alternative and only empty other alternatives keeps its index in these patterns.
+ * get and set work on raw bytes, so such a variant can't be used in constant expressions. No type has
+ * a specialization by default, e.g. variant<bool> keeps a separate index and stays constexpr */
+template <typename T>
+struct niche_traits {
+  static constexpr std::size_t count = 0;
+};
+
+namespace variant_impl {
+
+/* Index of the alternative keeping index of the whole variant or sizeof...(Types) if there is none:
+ * it must have a spare pattern for every other alternative and for valueless state,
+ * other alternatives must be empty so that they never touch its bytes */
+template <typename... Types>
+constexpr std::size_t niche_index() {
+  constexpr std::size_t count = sizeof...(Types);
+  constexpr bool spare[] = {(niche_traits<std::remove_cv_t<Types>>::count >= count)..., false};
+  constexpr bool empty[] = {std::is_empty_v<Types>..., false};
+  std::size_t non_empty = 0;
+  std::size_t candidate = count;
+  for (std::size_t i = 0; i < count; ++i) {
+    if (!empty[i]) {
+      ++non_empty;
+      candidate = i;
+    }
+  }
+  return (non_empty == 1 && spare[candidate]) ? candidate : count;
+}
+
+template <typename... Types>
+inline constexpr bool has_niche = niche_index<Types...>() < sizeof...(Types);
+
+/* Types with bit patterns that are not values: bool and niche alternatives */
+template <typename T>
+inline constexpr bool has_invalid_bytes = std::is_same_v<T, bool> || niche_traits<T>::count > 0;
+
+/* Whether bytes at p may hold a value of T, used to check untrusted input copied into an alternative:
+ * a bool must be 0 or 1 and a niche alternative must not hold a spare pattern */
+template <typename T>
+bool valid_object_bytes(void const* p) noexcept {
+  if constexpr (std::is_same_v<T, bool>) {
+    static_assert(sizeof(bool) == 1, "bool is expected to take exactly one byte");
+    return *static_cast<unsigned char const*>(p) < 2;
+  } else if constexpr (niche_traits<T>::count > 0) {
+    return niche_traits<T>::get(p) == niche_traits<T>::count;
+  } else {
+    return true;
+  }
+}
+
+}
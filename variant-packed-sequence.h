@@ -0,0 +1,470 @@
+#pragma once
+
+#include "variant-vector.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+/* Append-only sequence of variants stored back to back in one buffer: every element is its index
+ * followed by its alternative with that alternative's own size and alignment, so small alternatives
+ * don't pay for the largest one. Iteration is forward only, random access needs the side index
+ * enabled by enable_index(). Elements are never valueless */
+template <typename... Types>
+struct packed_variant_sequence {
+private:
+  using index_type = variant_impl::index_t<sizeof...(Types)>;
+  template <std::size_t Id>
+  using alternative_t = typename variant_impl::alternative_by_index<Id, Types...>::type;
+
+  constexpr static std::size_t sizes[] = {sizeof(Types)...};
+  constexpr static std::size_t alignments[] = {alignof(Types)...};
+  constexpr static std::size_t buffer_align = std::max({alignof(index_type), alignof(Types)...});
+  constexpr static std::size_t initial_capacity = 256;
+
+  /* Offsets are counted from the buffer, which is aligned for every alternative */
+  constexpr static std::size_t align_up(std::size_t offset, std::size_t alignment) noexcept {
+    return (offset + alignment - 1) & ~(alignment - 1);
+  }
+
+  constexpr static std::size_t payload_offset(std::size_t tag_offset, std::size_t index) noexcept {
+    return align_up(tag_offset + sizeof(index_type), alignments[index]);
+  }
+
+  constexpr static std::size_t next_offset(std::size_t tag_offset, std::size_t index) noexcept {
+    return align_up(payload_offset(tag_offset, index) + sizes[index], alignof(index_type));
+  }
+
+  template <bool Const>
+  struct basic_iterator {
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = variant<Types...>;
+    using difference_type = std::ptrdiff_t;
+    using reference = variant_impl::variant_vector_reference<Const, Types...>;
+    using pointer = void;
+
+    basic_iterator() noexcept = default;
+
+    template <bool OtherConst>
+    requires(Const && !OtherConst)
+    basic_iterator(basic_iterator<OtherConst> const& other) noexcept
+        : data(other.data), offset(other.offset) {}
+
+    reference operator*() const noexcept {
+      return element<reference>(data, offset);
+    }
+
+    basic_iterator& operator++() noexcept {
+      offset = next_offset(offset, tag_at(data, offset));
+      return *this;
+    }
+
+    basic_iterator operator++(int) noexcept {
+      basic_iterator result = *this;
+      ++*this;
+      return result;
+    }
+
+    bool operator==(basic_iterator const& other) const noexcept {
+      return offset == other.offset;
+    }
+
+  private:
+    friend struct packed_variant_sequence;
+    friend struct basic_iterator<true>;
+
+    using data_t = std::conditional_t<Const, unsigned char const*, unsigned char*>;
+
+    basic_iterator(data_t data, std::size_t offset) noexcept
+        : data(data), offset(offset) {}
+
+    data_t data = nullptr;
+    std::size_t offset = 0;
+  };
+
+public:
+  using value_type = variant<Types...>;
+  using reference = variant_impl::variant_vector_reference<false, Types...>;
+  using const_reference = variant_impl::variant_vector_reference<true, Types...>;
+  using iterator = basic_iterator<false>;
+  using const_iterator = basic_iterator<true>;
+
+  packed_variant_sequence() noexcept = default;
+
+  packed_variant_sequence(packed_variant_sequence const& other)
+      requires(CopyConstructible<Types...>)
+      : offsets(other.offsets), indexed(other.indexed) {
+    if (other.used == 0) {
+      return;
+    }
+    allocate(other.used);
+    if constexpr ((std::is_trivially_copy_constructible_v<Types> && ...)) {
+      std::memcpy(data, other.data, other.used);
+      used = other.used;
+      length = other.length;
+    } else {
+      try {
+        while (used < other.used) {
+          std::size_t index = tag_at(other.data, used);
+          std::memcpy(data + used, other.data + used, sizeof(index_type));
+          variant_impl::dispatch<void, sizeof...(Types)>(index, [&](auto id) {
+            new (data + payload_offset(used, id)) alternative_t<id>(other.template alternative<id>(used));
+          });
+          used = next_offset(used, index);
+          ++length;
+        }
+      } catch (...) {
+        clear();
+        deallocate();
+        throw;
+      }
+    }
+  }
+
+  packed_variant_sequence(packed_variant_sequence&& other) noexcept
+      : data(std::exchange(other.data, nullptr)),
+        used(std::exchange(other.used, 0)),
+        reserved(std::exchange(other.reserved, 0)),
+        length(std::exchange(other.length, 0)),
+        offsets(std::move(other.offsets)),
+        indexed(std::exchange(other.indexed, false)) {}
+
+  packed_variant_sequence& operator=(packed_variant_sequence const& other)
+      requires(CopyConstructible<Types...>) {
+    if (this != &other) {
+      packed_variant_sequence copy(other);
+      swap(copy);
+    }
+    return *this;
+  }
+
+  packed_variant_sequence& operator=(packed_variant_sequence&& other) noexcept {
+    packed_variant_sequence moved(std::move(other));
+    swap(moved);
+    return *this;
+  }
+
+  ~packed_variant_sequence() {
+    clear();
+    deallocate();
+  }
+
+
+  std::size_t size() const noexcept {
+    return length;
+  }
+
+  bool empty() const noexcept {
+    return length == 0;
+  }
+
+  /* Bytes taken by the elements, including alignment padding */
+  std::size_t bytes() const noexcept {
+    return used;
+  }
+
+  std::size_t capacity_bytes() const noexcept {
+    return reserved;
+  }
+
+  void reserve_bytes(std::size_t new_capacity) {
+    if (new_capacity > reserved) {
+      reallocate(new_capacity, [](unsigned char*) {}, variant_npos);
+    }
+  }
+
+
+  iterator begin() noexcept {
+    return iterator(data, 0);
+  }
+
+  const_iterator begin() const noexcept {
+    return const_iterator(data, 0);
+  }
+
+  iterator end() noexcept {
+    return iterator(data, used);
+  }
+
+  const_iterator end() const noexcept {
+    return const_iterator(data, used);
+  }
+
+
+  /* Side index keeps the offset of every element, it is built for the elements already appended
+   * and then maintained by every append */
+  void enable_index() {
+    if (indexed) {
+      return;
+    }
+    offsets.clear();
+    offsets.reserve(length);
+    for (std::size_t offset = 0; offset != used; offset = next_offset(offset, tag_at(data, offset))) {
+      offsets.push_back(offset);
+    }
+    indexed = true;
+  }
+
+  bool has_index() const noexcept {
+    return indexed;
+  }
+
+  reference operator[](std::size_t pos) noexcept {
+    assert(indexed && "random access to packed_variant_sequence without index");
+    return element<reference>(data, offsets[pos]);
+  }
+
+  const_reference operator[](std::size_t pos) const noexcept {
+    assert(indexed && "random access to packed_variant_sequence without index");
+    return element<const_reference>(data, offsets[pos]);
+  }
+
+  reference at(std::size_t pos) {
+    check_access(pos);
+    return (*this)[pos];
+  }
+
+  const_reference at(std::size_t pos) const {
+    check_access(pos);
+    return (*this)[pos];
+  }
+
+
+  /* Arguments may refer to elements of this sequence: on reallocation the new element is constructed
+   * in the new buffer before the old elements are moved there */
+  template <std::size_t Id, typename... Args>
+  requires(InBound<Id, Types...> && ConstructibleFrom<alternative_t<Id>, Args...>)
+  variant_impl::unboxed_t<alternative_t<Id>>& emplace_back(Args&&... args) {
+    std::size_t tag_offset = used;
+    std::size_t end_offset = next_offset(tag_offset, Id);
+    /* Offset goes first and is taken back if the element throws, so the side index grows geometrically
+     * and the sequence is left unchanged on exception */
+    if (indexed) {
+      offsets.push_back(tag_offset);
+    }
+    auto build = [&](unsigned char* buffer) {
+      new (buffer + payload_offset(tag_offset, Id)) alternative_t<Id>(std::forward<Args>(args)...);
+      index_type tag = static_cast<index_type>(Id);
+      std::memcpy(buffer + tag_offset, &tag, sizeof(index_type));
+    };
+    try {
+      if (end_offset > reserved) {
+        reallocate(std::max({end_offset, 2 * reserved, initial_capacity}), build, Id);
+      } else {
+        build(data);
+      }
+    } catch (...) {
+      if (indexed) {
+        offsets.pop_back();
+      }
+      throw;
+    }
+    used = end_offset;
+    ++length;
+    return variant_impl::unbox(alternative<Id>(tag_offset));
+  }
+
+  template <typename T, typename... Args>
+  requires(UniqueEntry<T, Types...> && ConstructibleFrom<T, Args...>)
+  variant_impl::unboxed_t<T>& emplace_back(Args&&... args) {
+    return emplace_back<variant_impl::index_by_type<T, 0, Types...>::index>(std::forward<Args>(args)...);
+  }
+
+  void push_back(variant<Types...> const& v)
+      requires(CopyConstructible<Types...>) {
+    if (v.valueless_by_exception()) {
+      throw bad_variant_access("push_back of valueless variant");
+    }
+    variant_impl::dispatch<void, sizeof...(Types)>(v.index(), [&](auto id) {
+      emplace_back<id>(get<id>(v.current_storage()));
+    });
+  }
+
+  void push_back(variant<Types...>&& v)
+      requires(MoveConstructible<Types...>) {
+    if (v.valueless_by_exception()) {
+      throw bad_variant_access("push_back of valueless variant");
+    }
+    variant_impl::dispatch<void, sizeof...(Types)>(v.index(), [&](auto id) {
+      emplace_back<id>(std::move(get<id>(v.current_storage())));
+    });
+  }
+
+  /* Alternative is chosen as by the converting constructor of variant */
+  template <typename T,
+      typename T_j = decltype(variant_impl::converting_ctor_getter<T, Types...>::imaginary_func(std::declval<T&&>())),
+      std::size_t J = variant_impl::index_by_type<T_j, 0, Types...>::index>
+  requires(!std::is_same_v<std::remove_cvref_t<T>, variant<Types...>> && std::is_constructible_v<T_j, T>)
+  void push_back(T&& t) {
+    emplace_back<J>(std::forward<T>(t));
+  }
+
+  /* Destroys every element, the buffer is kept */
+  void clear() noexcept {
+    if constexpr (!TriviallyDestructible<Types...>) {
+      for (std::size_t offset = 0; offset != used;) {
+        std::size_t index = tag_at(data, offset);
+        destroy(offset, index);
+        offset = next_offset(offset, index);
+      }
+    }
+    used = 0;
+    length = 0;
+    offsets.clear();
+  }
+
+  void swap(packed_variant_sequence& other) noexcept {
+    std::swap(data, other.data);
+    std::swap(used, other.used);
+    std::swap(reserved, other.reserved);
+    std::swap(length, other.length);
+    offsets.swap(other.offsets);
+    std::swap(indexed, other.indexed);
+  }
+
+
+  /* Calls vis with every element in order. Next offset is computed from the static index,
+   * so it doesn't wait for the load of the next tag */
+  template <typename Visitor>
+  void visit_each(Visitor&& vis) {
+    for (std::size_t offset = 0; offset != used;) {
+      variant_impl::dispatch<void, sizeof...(Types)>(tag_at(data, offset), [&](auto id) {
+        vis(variant_impl::unbox(alternative<id>(offset)));
+        offset = next_offset(offset, id);
+      });
+    }
+  }
+
+  template <typename Visitor>
+  void visit_each(Visitor&& vis) const {
+    for (std::size_t offset = 0; offset != used;) {
+      variant_impl::dispatch<void, sizeof...(Types)>(tag_at(data, offset), [&](auto id) {
+        vis(variant_impl::unbox(alternative<id>(offset)));
+        offset = next_offset(offset, id);
+      });
+    }
+  }
+
+private:
+  static std::size_t tag_at(unsigned char const* buffer, std::size_t offset) noexcept {
+    return *std::launder(reinterpret_cast<index_type const*>(buffer + offset));
+  }
+
+  template <typename Reference, typename Buffer>
+  static Reference element(Buffer buffer, std::size_t offset) noexcept {
+    auto const* tag = std::launder(reinterpret_cast<index_type const*>(buffer + offset));
+    return Reference(tag, buffer + payload_offset(offset, *tag));
+  }
+
+  template <std::size_t Id>
+  alternative_t<Id>& alternative(std::size_t tag_offset) noexcept {
+    return *std::launder(reinterpret_cast<alternative_t<Id>*>(data + payload_offset(tag_offset, Id)));
+  }
+
+  template <std::size_t Id>
+  alternative_t<Id> const& alternative(std::size_t tag_offset) const noexcept {
+    return *std::launder(reinterpret_cast<alternative_t<Id> const*>(data + payload_offset(tag_offset, Id)));
+  }
+
+  void destroy(std::size_t tag_offset, std::size_t index) noexcept {
+    variant_impl::dispatch<void, sizeof...(Types)>(index, [&](auto id) {
+      using T = alternative_t<id>;
+      alternative<id>(tag_offset).~T();
+    });
+  }
+
+  void check_access(std::size_t pos) const {
+    if (!indexed) {
+      throw std::logic_error("packed_variant_sequence::at without index");
+    }
+    if (pos >= length) {
+      throw std::out_of_range("packed_variant_sequence::at");
+    }
+  }
+
+  void allocate(std::size_t count) {
+    data = static_cast<unsigned char*>(::operator new(count, std::align_val_t(buffer_align)));
+    reserved = count;
+  }
+
+  void deallocate() noexcept {
+    if (data != nullptr) {
+      ::operator delete(data, std::align_val_t(buffer_align));
+    }
+    data = nullptr;
+    reserved = 0;
+  }
+
+  /* Moves elements to a new buffer of new_capacity bytes at the same offsets, build constructs
+   * alternative built_index at offset used first, variant_npos means there is no new element.
+   * Elements are relocated if that can't throw, otherwise they are copied or moved as by
+   * std::move_if_noexcept and the old buffer is left untouched on exception */
+  template <typename Build>
+  void reallocate(std::size_t new_capacity, Build&& build, std::size_t built_index) {
+    packed_variant_sequence fresh;
+    fresh.allocate(new_capacity);
+    build(fresh.data);
+
+    if constexpr (TriviallyRelocatable<Types...>) {
+      if (used != 0) {
+        std::memcpy(fresh.data, data, used);
+      }
+    } else if constexpr (NothrowRelocatable<Types...>) {
+      for (std::size_t offset = 0; offset != used;) {
+        std::size_t index = tag_at(data, offset);
+        std::memcpy(fresh.data + offset, data + offset, sizeof(index_type));
+        variant_impl::dispatch<void, sizeof...(Types)>(index, [&](auto id) {
+          relocate(&alternative<id>(offset), &fresh.template alternative<id>(offset));
+        });
+        offset = next_offset(offset, index);
+      }
+    } else {
+      try {
+        while (fresh.used != used) {
+          std::size_t index = tag_at(data, fresh.used);
+          std::memcpy(fresh.data + fresh.used, data + fresh.used, sizeof(index_type));
+          variant_impl::dispatch<void, sizeof...(Types)>(index, [&](auto id) {
+            new (fresh.data + payload_offset(fresh.used, id))
+                alternative_t<id>(std::move_if_noexcept(alternative<id>(fresh.used)));
+          });
+          fresh.used = next_offset(fresh.used, index);
+        }
+      } catch (...) {
+        if (built_index != variant_npos) {
+          fresh.destroy(used, built_index);
+        }
+        fresh.clear();
+        throw;
+      }
+      fresh.used = 0;
+      for (std::size_t offset = 0; offset != used;) {
+        std::size_t index = tag_at(data, offset);
+        destroy(offset, index);
+        offset = next_offset(offset, index);
+      }
+    }
+    std::swap(data, fresh.data);
+    std::swap(reserved, fresh.reserved);
+  }
+
+  unsigned char* data = nullptr;
+  std::size_t used = 0;
+  std::size_t reserved = 0;
+  std::size_t length = 0;
+  std::vector<std::size_t> offsets;
+  bool indexed = false;
+};
+
+
+template <typename... Types>
+void swap(packed_variant_sequence<Types...>& lhs, packed_variant_sequence<Types...>& rhs) noexcept {
+  lhs.swap(rhs);
+}
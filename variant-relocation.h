@@ -0,0 +1,111 @@
+#pragma once
+
+#include "variant-helpers.h"
+
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+
+/* Opt-in trait: objects of T may be moved to another address by copying their bytes,
+ * after which the source is treated as destroyed without calling its destructor.
+ * True for trivially copyable types, a specialization may set it for others */
+template <typename T>
+struct is_trivially_relocatable
+    : std::bool_constant<std::is_trivially_copyable_v<T>> {};
+
+template <typename T>
+inline constexpr bool is_trivially_relocatable_v = is_trivially_relocatable<T>::value;
+
+template <typename T>
+struct is_trivially_relocatable<const T>
+    : is_trivially_relocatable<T> {};
+
+/* Both standard libraries keep only pointers to the owned object and the control block */
+template <typename T>
+struct is_trivially_relocatable<std::unique_ptr<T>>
+    : std::true_type {};
+
+template <typename T>
+struct is_trivially_relocatable<std::shared_ptr<T>>
+    : std::true_type {};
+
+/* Box owns its object through the pointer, so it moves with its allocator, stateless one has no bytes to move */
+template <typename T, typename Allocator>
+struct is_trivially_relocatable<box<T, Allocator>>
+    : std::bool_constant<(std::is_empty_v<Allocator> || is_trivially_relocatable_v<Allocator>) &&
+                         is_trivially_relocatable_v<typename std::allocator_traits<Allocator>::pointer>> {};
+
+template <typename T, typename Allocator>
+struct is_trivially_relocatable<recursive_wrapper<T, Allocator>>
+    : is_trivially_relocatable<box<T, Allocator>> {};
+
+/* Variant is relocated together with its index, so it only needs every alternative to be relocatable */
+template <typename... Types>
+struct is_trivially_relocatable<variant<Types...>>
+    : std::bool_constant<(is_trivially_relocatable_v<Types> && ...)> {};
+
+
+template <typename... Types>
+concept TriviallyRelocatable = (is_trivially_relocatable_v<Types> && ...);
+
+template <typename... Types>
+concept NothrowRelocatable = ((is_trivially_relocatable_v<Types> || std::is_nothrow_move_constructible_v<Types>) && ...);
+
+
+/* Moves *source into uninitialized destination and ends the lifetime of *source */
+template <typename T>
+T* relocate(T* source, T* destination) noexcept(NothrowRelocatable<T>) {
+  if constexpr (TriviallyRelocatable<T>) {
+    std::memcpy(static_cast<void*>(destination), static_cast<void const*>(source), sizeof(T));
+  } else {
+    new (const_cast<std::remove_cv_t<T>*>(destination)) T(std::move(*source));
+    source->~T();
+  }
+  return destination;
+}
+
+/* Relocates [first, last) into uninitialized storage starting at destination, ranges must not overlap.
+ * Trivially relocatable objects are moved as one block. Returns the end of the destination range */
+template <typename T>
+T* uninitialized_relocate(T* first, T* last, T* destination) noexcept(NothrowRelocatable<T>) {
+  if constexpr (TriviallyRelocatable<T>) {
+    if (first != last) {
+      std::memcpy(static_cast<void*>(destination), static_cast<void const*>(first),
+                  static_cast<std::size_t>(last - first) * sizeof(T));
+    }
+    return destination + (last - first);
+  } else if constexpr (std::is_nothrow_move_constructible_v<T>) {
+    for (; first != last; ++first, ++destination) {
+      relocate(first, destination);
+    }
+    return destination;
+  } else {
+    T* constructed = destination;
+    try {
+      for (T* current = first; current != last; ++current, ++constructed) {
+        new (const_cast<std::remove_cv_t<T>*>(constructed)) T(std::move(*current));
+      }
+    } catch (...) {
+      std::destroy(destination, constructed);
+      throw;
+    }
+    std::destroy(first, last);
+    return constructed;
+  }
+}
+
+
+namespace variant_impl {
+
+/* Exchanges two trivially relocatable objects by relocating both through a buffer */
+template <typename T>
+void swap_bytes(T& a, T& b) noexcept {
+  unsigned char buffer[sizeof(T)];
+  std::memcpy(buffer, static_cast<void const*>(std::addressof(a)), sizeof(T));
+  std::memcpy(static_cast<void*>(std::addressof(a)), static_cast<void const*>(std::addressof(b)), sizeof(T));
+  std::memcpy(static_cast<void*>(std::addressof(b)), buffer, sizeof(T));
+}
+
+}
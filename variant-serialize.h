@@ -0,0 +1,293 @@
+#pragma once
+
+#include "variant.h"
+
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <source_location>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+
+/* Wire format: 4-byte fingerprint of the variant type, index in the smallest type that holds it, payload.
+ * Integers are written in native byte order, the fingerprint covers it, so peers of different endianness
+ * or with different alternatives reject each other's messages before looking at the payload.
+ * The fingerprint hashes type names as the compiler spells them, so fingerprints are only comparable
+ * between binaries built by the same compiler */
+struct bad_variant_encoding : std::runtime_error {
+  explicit bad_variant_encoding(const std::string& arg)
+      : std::runtime_error(arg) {}
+
+  explicit bad_variant_encoding(const char* arg)
+      : std::runtime_error(arg) {}
+};
+
+
+/* Customization point for alternatives that are not trivially copyable. A specialization provides
+ *   static std::size_t size(T const& value)                      - number of payload bytes of value,
+ *   static void write(T const& value, std::byte* out)            - writes exactly size(value) bytes,
+ *   static std::size_t read(std::span<std::byte const> in, void* place)
+ *                                                                - constructs T at place from the front of in,
+ *                                                                  returns the number of bytes read and throws
+ *                                                                  bad_variant_encoding if in is malformed,
+ * and optionally static constexpr std::uint32_t version, which is mixed into the fingerprint.
+ * Trivially copyable alternatives other than pointers are copied as raw bytes without a specialization */
+template <typename T>
+struct variant_serializer;
+
+
+/* Length as 8 bytes, then the characters */
+template <typename Char, typename Traits, typename Allocator>
+  requires(std::is_trivially_copyable_v<Char>)
+struct variant_serializer<std::basic_string<Char, Traits, Allocator>> {
+  using string_t = std::basic_string<Char, Traits, Allocator>;
+
+  static std::size_t size(string_t const& value) noexcept {
+    return sizeof(std::uint64_t) + value.size() * sizeof(Char);
+  }
+
+  static void write(string_t const& value, std::byte* out) noexcept {
+    std::uint64_t length = value.size();
+    std::memcpy(out, &length, sizeof(length));
+    if (length != 0) {
+      std::memcpy(out + sizeof(length), value.data(), value.size() * sizeof(Char));
+    }
+  }
+
+  static std::size_t read(std::span<std::byte const> in, void* place) {
+    std::uint64_t length;
+    if (in.size() < sizeof(length)) {
+      throw bad_variant_encoding("truncated string length");
+    }
+    std::memcpy(&length, in.data(), sizeof(length));
+    if (length > (in.size() - sizeof(length)) / sizeof(Char)) {
+      throw bad_variant_encoding("truncated string");
+    }
+    std::size_t count = static_cast<std::size_t>(length);
+    if constexpr (alignof(Char) == 1) {
+      new (place) string_t(reinterpret_cast<Char const*>(in.data() + sizeof(length)), count);
+    } else {
+      string_t* value = new (place) string_t(count, Char());
+      if (count != 0) {
+        std::memcpy(value->data(), in.data() + sizeof(length), count * sizeof(Char));
+      }
+    }
+    return sizeof(length) + count * sizeof(Char);
+  }
+};
+
+
+namespace variant_impl {
+
+template <typename T>
+concept CustomSerializable = requires(T const& value, std::byte* out, std::span<std::byte const> in, void* place) {
+  { variant_serializer<T>::size(value) } -> std::convertible_to<std::size_t>;
+  variant_serializer<T>::write(value, out);
+  { variant_serializer<T>::read(in, place) } -> std::convertible_to<std::size_t>;
+};
+
+/* Pointers are trivially copyable too, but meaningless in another process */
+template <typename T>
+concept RawSerializable = std::is_trivially_copyable_v<T> && !std::is_pointer_v<T> && !std::is_member_pointer_v<T>;
+
+template <typename T>
+concept Serializable = CustomSerializable<std::remove_cv_t<T>> || RawSerializable<T>;
+
+
+/* Name of T as spelled by the compiler, both peers must be built with the same one */
+template <typename T>
+constexpr std::string_view type_name() noexcept {
+  return std::source_location::current().function_name();
+}
+
+static_assert(type_name<int>() != type_name<long>(),
+              "function_name() doesn't spell template arguments, the fingerprint would not tell alternatives apart");
+
+constexpr std::uint32_t fnv1a(std::uint32_t hash, std::string_view bytes) noexcept {
+  for (char c : bytes) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+  }
+  return hash;
+}
+
+constexpr std::uint32_t fnv1a(std::uint32_t hash, std::uint64_t value) noexcept {
+  for (int i = 0; i < 8; ++i) {
+    hash = (hash ^ static_cast<std::uint32_t>((value >> (8 * i)) & 0xff)) * 16777619u;
+  }
+  return hash;
+}
+
+template <typename T>
+constexpr std::uint32_t alternative_fingerprint(std::uint32_t hash) noexcept {
+  using value_t = std::remove_cv_t<T>;
+  hash = fnv1a(hash, type_name<value_t>());
+  if constexpr (CustomSerializable<value_t>) {
+    if constexpr (requires { variant_serializer<value_t>::version; }) {
+      hash = fnv1a(hash, static_cast<std::uint64_t>(variant_serializer<value_t>::version));
+    }
+  } else {
+    hash = fnv1a(hash, sizeof(value_t));
+  }
+  return hash;
+}
+
+template <typename... Types>
+constexpr std::uint32_t fingerprint() noexcept {
+  std::uint32_t hash = fnv1a(2166136261u, static_cast<std::uint64_t>(std::endian::native == std::endian::little));
+  hash = fnv1a(hash, sizeof...(Types));
+  ((hash = alternative_fingerprint<Types>(hash)), ...);
+  return hash;
+}
+
+template <typename... Types>
+inline constexpr std::size_t encoding_header_size = sizeof(std::uint32_t) + sizeof(index_t<sizeof...(Types)>);
+
+template <typename T>
+std::size_t payload_size(T const& value) {
+  if constexpr (CustomSerializable<std::remove_cv_t<T>>) {
+    return variant_serializer<std::remove_cv_t<T>>::size(value);
+  } else {
+    return sizeof(T);
+  }
+}
+
+/* Constructs alternative Id of var from the payload at the front of in, returns the number of bytes read.
+ * Fresh variant is valueless and gets the alternative built directly in its storage,
+ * otherwise the current alternative is replaced the way emplace does it */
+template <std::size_t Id, bool Fresh, typename... Types>
+std::size_t decode_alternative(std::span<std::byte const> in, variant<Types...>& var) {
+  using T = std::remove_cv_t<typename alternative_by_index<Id, Types...>::type>;
+  std::size_t consumed = 0;
+  auto build = [&](auto& storage) {
+    void* place = const_cast<T*>(std::addressof(get<Id>(storage)));
+    if constexpr (CustomSerializable<T>) {
+      consumed = variant_serializer<T>::read(in, place);
+    } else {
+      std::memcpy(place, in.data(), sizeof(T));
+      consumed = sizeof(T);
+    }
+  };
+  if constexpr (!CustomSerializable<T>) {
+    if (in.size() < sizeof(T)) {
+      throw bad_variant_encoding("truncated payload");
+    }
+    /* Bytes are checked before they are copied, a pattern of a niche alternative would change the index */
+    if constexpr (has_invalid_bytes<T>) {
+      alignas(T) unsigned char copy[sizeof(T)];
+      std::memcpy(copy, in.data(), sizeof(T));
+      if (!valid_object_bytes<T>(copy)) {
+        throw bad_variant_encoding("invalid value of alternative");
+      }
+    }
+  }
+  if constexpr (Fresh) {
+    build(var.current_storage());
+    var.set_index(Id);
+  } else {
+    replace_alternative<!CustomSerializable<T>>(var, Id, build);
+  }
+  return consumed;
+}
+
+template <bool Fresh, typename... Types>
+std::size_t decode(std::span<std::byte const> in, variant<Types...>& var) {
+  using index_type = index_t<sizeof...(Types)>;
+  if (in.size() < encoding_header_size<Types...>) {
+    throw bad_variant_encoding("truncated header");
+  }
+  constexpr std::uint32_t expected = fingerprint<Types...>();
+  std::uint32_t fingerprint_read;
+  std::memcpy(&fingerprint_read, in.data(), sizeof(fingerprint_read));
+  if (fingerprint_read != expected) {
+    throw bad_variant_encoding("fingerprint mismatch");
+  }
+  index_type index;
+  std::memcpy(&index, in.data() + sizeof(fingerprint_read), sizeof(index));
+  if (index >= sizeof...(Types)) {
+    throw bad_variant_encoding("invalid index");
+  }
+  std::span<std::byte const> payload = in.subspan(encoding_header_size<Types...>);
+  return encoding_header_size<Types...> + dispatch<std::size_t, sizeof...(Types)>(index, [&](auto id) {
+    return decode_alternative<id, Fresh>(payload, var);
+  });
+}
+
+}
+
+
+/* Compile time fingerprint written in front of every message: alternatives, their sizes or serializer versions
+ * and byte order. Equal fingerprints of different types are possible, but unlikely */
+template <typename Variant>
+inline constexpr std::uint32_t variant_fingerprint_v = 0;
+
+template <typename... Types>
+inline constexpr std::uint32_t variant_fingerprint_v<variant<Types...>> = variant_impl::fingerprint<Types...>();
+
+
+/* Number of bytes serialize(v, out) writes */
+template <typename... Types>
+  requires(variant_impl::Serializable<Types> && ...)
+std::size_t serialized_size(variant<Types...> const& v) {
+  if (v.valueless_by_exception()) {
+    throw bad_variant_access("serialize valueless variant");
+  }
+  return variant_impl::encoding_header_size<Types...> +
+         variant_impl::dispatch<std::size_t, sizeof...(Types)>(v.index(), [&](auto id) {
+           return variant_impl::payload_size(get<id>(v.current_storage()));
+         });
+}
+
+/* Writes v to the front of out, returns the number of bytes written.
+ * Throws bad_variant_access if v is valueless and std::length_error if out is too small, then out is not touched */
+template <typename... Types>
+  requires(variant_impl::Serializable<Types> && ...)
+std::size_t serialize(variant<Types...> const& v, std::span<std::byte> out) {
+  using index_type = variant_impl::index_t<sizeof...(Types)>;
+  constexpr std::size_t header_size = variant_impl::encoding_header_size<Types...>;
+  if (v.valueless_by_exception()) {
+    throw bad_variant_access("serialize valueless variant");
+  }
+  return variant_impl::dispatch<std::size_t, sizeof...(Types)>(v.index(), [&](auto id) {
+    auto const& value = get<id>(v.current_storage());
+    using T = std::remove_cvref_t<decltype(value)>;
+    std::size_t size = header_size + variant_impl::payload_size(value);
+    if (out.size() < size) {
+      throw std::length_error("buffer is too small for the serialized variant");
+    }
+    std::uint32_t fingerprint = variant_fingerprint_v<variant<Types...>>;
+    index_type index = static_cast<index_type>(id);
+    std::memcpy(out.data(), &fingerprint, sizeof(fingerprint));
+    std::memcpy(out.data() + sizeof(fingerprint), &index, sizeof(index));
+    if constexpr (variant_impl::CustomSerializable<T>) {
+      variant_serializer<T>::write(value, out.data() + header_size);
+    } else {
+      std::memcpy(out.data() + header_size, std::addressof(value), sizeof(T));
+    }
+    return size;
+  });
+}
+
+/* Replaces the alternative of out with the one read from the front of in, returns the number of bytes read.
+ * Throws bad_variant_encoding if in was written for another type or is malformed: if the header is rejected
+ * out is not touched, if the payload is, out is left as a failed emplace would leave it */
+template <typename... Types>
+  requires(variant_impl::Serializable<Types> && ...)
+std::size_t deserialize(std::span<std::byte const> in, variant<Types...>& out) {
+  return variant_impl::decode<false>(in, out);
+}
+
+/* Reads a variant from the front of in, its alternative is constructed directly in the returned variant */
+template <typename Variant>
+  requires(variant_impl::is_variant_specialization<Variant>::value)
+Variant deserialize(std::span<std::byte const> in) {
+  Variant result = variant_impl::valueless_construct_t::make<Variant>();
+  variant_impl::decode<true>(in, result);
+  return result;
+}
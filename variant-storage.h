@@ -90,10 +90,99 @@ union storage_t<T0, TRest...> {
   storage_t<TRest...> rest_alternatives;
 };
 
+/* Above this number of alternatives storage is a balanced tree of unions,
+ * so reaching an alternative takes logarithmic instead of linear number of levels */
+inline constexpr std::size_t tree_storage_threshold = 16;
+
+template <typename... Types>
+concept TreeStorageSized = (sizeof...(Types) > tree_storage_threshold);
+
+
+template <typename... Types>
+struct storage_halves {
+  constexpr static std::size_t left_size = sizeof...(Types) / 2;
+  using left_t = typename slice_types<storage_t, 0, std::make_index_sequence<left_size>, Types...>::type;
+  using right_t = typename slice_types<storage_t, left_size,
+                                       std::make_index_sequence<sizeof...(Types) - left_size>, Types...>::type;
+};
+
+
+template <typename T0, typename... TRest>
+requires(TreeStorageSized<T0, TRest...> && TriviallyDestructible<T0, TRest...>)
+union storage_t<T0, TRest...> {
+  using halves = storage_halves<T0, TRest...>;
+  constexpr static std::size_t left_size = halves::left_size;
+
+  constexpr storage_t()
+      : right()
+  {}
+
+  template <std::size_t Id, typename... Args>
+  requires(Id < left_size)
+  constexpr explicit storage_t(in_place_index_t<Id>, Args&&... args)
+      : left(in_place_index<Id>, std::forward<Args>(args)...)
+  {}
+
+  template <std::size_t Id, typename... Args>
+  requires(Id >= left_size)
+  constexpr explicit storage_t(in_place_index_t<Id>, Args&&... args)
+      : right(in_place_index<Id - left_size>, std::forward<Args>(args)...)
+  {}
+
+  constexpr ~storage_t() = default;
+
+  typename halves::left_t left;
+  typename halves::right_t right;
+};
+
+
+template <typename T0, typename... TRest>
+requires(TreeStorageSized<T0, TRest...>)
+union storage_t<T0, TRest...> {
+  using halves = storage_halves<T0, TRest...>;
+  constexpr static std::size_t left_size = halves::left_size;
+
+  constexpr storage_t()
+      : right()
+  {}
+
+  template <std::size_t Id, typename... Args>
+  requires(Id < left_size)
+  constexpr explicit storage_t(in_place_index_t<Id>, Args&&... args)
+      : left(in_place_index<Id>, std::forward<Args>(args)...)
+  {}
+
+  template <std::size_t Id, typename... Args>
+  requires(Id >= left_size)
+  constexpr explicit storage_t(in_place_index_t<Id>, Args&&... args)
+      : right(in_place_index<Id - left_size>, std::forward<Args>(args)...)
+  {}
+
+  constexpr ~storage_t()
+  {}
+
+  typename halves::left_t left;
+  typename halves::right_t right;
+};
+
+
+template <typename Storage>
+concept TreeStorage = requires {
+  std::remove_cvref_t<Storage>::left_size;
+};
+
+
 template <std::size_t Id, typename Storage>
 constexpr decltype(auto) get(Storage&& storage)
     requires(is_storage_t_specialization<std::remove_cvref_t<Storage>>::value) {
-  if constexpr (Id == 0) {
+  if constexpr (TreeStorage<Storage>) {
+    constexpr std::size_t left_size = std::remove_cvref_t<Storage>::left_size;
+    if constexpr (Id < left_size) {
+      return get<Id>(std::forward<Storage>(storage).left);
+    } else {
+      return get<Id - left_size>(std::forward<Storage>(storage).right);
+    }
+  } else if constexpr (Id == 0) {
     return storage.get_current();
   } else {
     return get<Id - 1>(
@@ -101,5 +190,34 @@ constexpr decltype(auto) get(Storage&& storage)
   }
 }
 
+template <std::size_t Id, typename Storage, typename... Args>
+constexpr void construct(Storage& storage, Args&&... args)
+    requires(is_storage_t_specialization<std::remove_cv_t<Storage>>::value) {
+  if constexpr (TreeStorage<Storage>) {
+    if constexpr (Id < Storage::left_size) {
+      construct<Id>(storage.left, std::forward<Args>(args)...);
+    } else {
+      construct<Id - Storage::left_size>(storage.right, std::forward<Args>(args)...);
+    }
+  } else if constexpr (Id == 0) {
+    storage.construct(std::forward<Args>(args)...);
+  } else {
+    construct<Id - 1>(storage.rest_alternatives, std::forward<Args>(args)...);
+  }
 }
 
+
+/* Constructs the alternative with the given index from the same alternative of source,
+ * which is forwarded with its value category */
+template <typename Storage, typename Source>
+constexpr void construct_from(Storage& storage, std::size_t index, Source&& source) {
+  dispatch<void, storage_size_v<Storage>>(index, [&](auto id) {
+    if constexpr (std::is_lvalue_reference_v<Source>) {
+      construct<id>(storage, get<id>(source));
+    } else {
+      construct<id>(storage, std::move(get<id>(source)));
+    }
+  });
+}
+
+}
@@ -1,7 +1,10 @@
 #pragma once
 
+#include "variant-box.h"
+
 #include <concepts>
 #include <type_traits>
+#include <utility>
 
 
 template <typename... Types>
@@ -79,9 +82,10 @@ template <typename... Types>
 concept Swappable = (std::is_swappable_v<Types> && ...);
 
 
+/* Boxed alternative is found both by box<T> and by T */
 template <typename T, typename... Types>
 concept UniqueEntry =
-    ((static_cast<std::size_t>(std::is_same_v<T, Types>) + ...) == 1);
+    ((static_cast<std::size_t>(std::is_same_v<T, Types> || std::is_same_v<T, variant_impl::unboxed_t<Types>>) + ...) == 1);
 
 template <typename T, typename... Args>
 concept ConstructibleFrom = (std::is_constructible_v<T, Args...>);
@@ -0,0 +1,439 @@
+#pragma once
+
+#include "variant.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+
+template <typename... Types>
+struct variant_vector;
+
+template <typename... Types>
+struct packed_variant_sequence;
+
+
+namespace variant_impl {
+
+/* Reference-like view of an element of variant_vector or packed_variant_sequence: index and payload
+ * are stored apart, so there is no variant object to refer to. Valid until the container is reallocated */
+template <bool Const, typename... Types>
+struct variant_vector_reference {
+private:
+  using index_type = index_t<sizeof...(Types)>;
+  template <std::size_t Id>
+  using alternative_t = std::conditional_t<Const, const typename alternative_by_index<Id, Types...>::type,
+                                           typename alternative_by_index<Id, Types...>::type>;
+
+  friend struct ::variant_vector<Types...>;
+  friend struct ::packed_variant_sequence<Types...>;
+  friend struct variant_vector_reference<true, Types...>;
+
+  constexpr variant_vector_reference(index_type const* tag, std::conditional_t<Const, void const*, void*> payload)
+      : tag(tag), payload(payload) {}
+
+  template <std::size_t Id>
+  using value_t = unboxed_t<alternative_t<Id>>;
+
+  template <std::size_t Id>
+  alternative_t<Id>& alternative() const noexcept {
+    return *std::launder(static_cast<alternative_t<Id>*>(payload));
+  }
+
+public:
+  template <bool OtherConst>
+  requires(Const && !OtherConst)
+  constexpr variant_vector_reference(variant_vector_reference<OtherConst, Types...> const& other) noexcept
+      : tag(other.tag), payload(other.payload) {}
+
+  constexpr std::size_t index() const noexcept {
+    return *tag;
+  }
+
+  template <std::size_t Id>
+  requires(InBound<Id, Types...>)
+  value_t<Id>& get() const {
+    if (index() != Id) {
+      throw bad_variant_access("accessing non-holding alternative");
+    }
+    return unbox(alternative<Id>());
+  }
+
+  template <typename T>
+  requires(UniqueEntry<T, Types...>)
+  std::conditional_t<Const, const unboxed_t<T>, unboxed_t<T>>& get() const {
+    return get<index_by_type<T, 0, Types...>::index>();
+  }
+
+  template <std::size_t Id>
+  requires(InBound<Id, Types...>)
+  value_t<Id>* get_if() const noexcept {
+    return index() == Id ? std::addressof(unbox(alternative<Id>())) : nullptr;
+  }
+
+  template <typename T>
+  requires(UniqueEntry<T, Types...>)
+  std::conditional_t<Const, const unboxed_t<T>, unboxed_t<T>>* get_if() const noexcept {
+    return get_if<index_by_type<T, 0, Types...>::index>();
+  }
+
+  template <typename T>
+  requires(UniqueEntry<T, Types...>)
+  bool holds_alternative() const noexcept {
+    return index() == index_by_type<T, 0, Types...>::index;
+  }
+
+  template <typename Visitor>
+  decltype(auto) visit(Visitor&& vis) const {
+    using result_t = decltype(std::forward<Visitor>(vis)(std::declval<value_t<0>&>()));
+    return dispatch<result_t, sizeof...(Types)>(index(), [&](auto id) -> result_t {
+      return std::forward<Visitor>(vis)(unbox(alternative<id>()));
+    });
+  }
+
+  operator variant<Types...>() const {
+    return dispatch<variant<Types...>, sizeof...(Types)>(index(), [&](auto id) {
+      return variant<Types...>(in_place_index<id>, alternative<id>());
+    });
+  }
+
+private:
+  index_type const* tag;
+  std::conditional_t<Const, void const*, void*> payload;
+};
+
+}
+
+
+/* Sequence of variants stored as two parallel arrays: a dense array of indexes (tags) and
+ * an array of payload slots as big as the largest alternative. Scans of the tags don't touch payloads.
+ * Elements are never valueless. Reallocation copies both arrays with memcpy if every alternative
+ * is trivially relocatable */
+template <typename... Types>
+struct variant_vector {
+private:
+  using index_type = variant_impl::index_t<sizeof...(Types)>;
+  template <std::size_t Id>
+  using alternative_t = typename variant_impl::alternative_by_index<Id, Types...>::type;
+
+  constexpr static std::size_t slot_align = std::max({alignof(Types)...});
+  constexpr static std::size_t slot_size = (std::max({sizeof(Types)...}) + slot_align - 1) / slot_align * slot_align;
+
+public:
+  using value_type = variant<Types...>;
+  using reference = variant_impl::variant_vector_reference<false, Types...>;
+  using const_reference = variant_impl::variant_vector_reference<true, Types...>;
+
+  variant_vector() noexcept = default;
+
+  variant_vector(variant_vector const& other)
+      requires(CopyConstructible<Types...>) {
+    if (other.length == 0) {
+      return;
+    }
+    allocate(other.length);
+    std::memcpy(tags, other.tags, other.length * sizeof(index_type));
+    if constexpr ((std::is_trivially_copy_constructible_v<Types> && ...)) {
+      std::memcpy(payloads, other.payloads, other.length * slot_size);
+      length = other.length;
+    } else {
+      try {
+        for (; length < other.length; ++length) {
+          variant_impl::dispatch<void, sizeof...(Types)>(tags[length], [&](auto id) {
+            new (slot(length)) alternative_t<id>(other.template alternative<id>(length));
+          });
+        }
+      } catch (...) {
+        clear();
+        deallocate();
+        throw;
+      }
+    }
+  }
+
+  variant_vector(variant_vector&& other) noexcept
+      : tags(std::exchange(other.tags, nullptr)),
+        payloads(std::exchange(other.payloads, nullptr)),
+        length(std::exchange(other.length, 0)),
+        reserved(std::exchange(other.reserved, 0)) {}
+
+  variant_vector& operator=(variant_vector const& other)
+      requires(CopyConstructible<Types...>) {
+    if (this != &other) {
+      variant_vector copy(other);
+      swap(copy);
+    }
+    return *this;
+  }
+
+  variant_vector& operator=(variant_vector&& other) noexcept {
+    variant_vector moved(std::move(other));
+    swap(moved);
+    return *this;
+  }
+
+  ~variant_vector() {
+    clear();
+    deallocate();
+  }
+
+
+  std::size_t size() const noexcept {
+    return length;
+  }
+
+  bool empty() const noexcept {
+    return length == 0;
+  }
+
+  std::size_t capacity() const noexcept {
+    return reserved;
+  }
+
+  void reserve(std::size_t new_capacity) {
+    if (new_capacity > reserved) {
+      reallocate(new_capacity, [](void*) {});
+    }
+  }
+
+
+  reference operator[](std::size_t pos) noexcept {
+    return reference(tags + pos, slot(pos));
+  }
+
+  const_reference operator[](std::size_t pos) const noexcept {
+    return const_reference(tags + pos, slot(pos));
+  }
+
+  reference at(std::size_t pos) {
+    if (pos >= length) {
+      throw std::out_of_range("variant_vector::at");
+    }
+    return (*this)[pos];
+  }
+
+  const_reference at(std::size_t pos) const {
+    if (pos >= length) {
+      throw std::out_of_range("variant_vector::at");
+    }
+    return (*this)[pos];
+  }
+
+  reference back() noexcept {
+    return (*this)[length - 1];
+  }
+
+  const_reference back() const noexcept {
+    return (*this)[length - 1];
+  }
+
+
+  /* Arguments may refer to elements of this vector: on reallocation the new element is constructed
+   * in the new storage before the old elements are moved there */
+  template <std::size_t Id, typename... Args>
+  requires(InBound<Id, Types...> && ConstructibleFrom<alternative_t<Id>, Args...>)
+  variant_impl::unboxed_t<alternative_t<Id>>& emplace_back(Args&&... args) {
+    auto build = [&](void* place) {
+      new (place) alternative_t<Id>(std::forward<Args>(args)...);
+    };
+    if (length == reserved) {
+      reallocate<Id>(reserved == 0 ? initial_capacity : 2 * reserved, build);
+    } else {
+      build(slot(length));
+    }
+    tags[length] = static_cast<index_type>(Id);
+    return variant_impl::unbox(alternative<Id>(length++));
+  }
+
+  template <typename T, typename... Args>
+  requires(UniqueEntry<T, Types...> && ConstructibleFrom<T, Args...>)
+  variant_impl::unboxed_t<T>& emplace_back(Args&&... args) {
+    return emplace_back<variant_impl::index_by_type<T, 0, Types...>::index>(std::forward<Args>(args)...);
+  }
+
+  void push_back(variant<Types...> const& v)
+      requires(CopyConstructible<Types...>) {
+    if (v.valueless_by_exception()) {
+      throw bad_variant_access("push_back of valueless variant");
+    }
+    variant_impl::dispatch<void, sizeof...(Types)>(v.index(), [&](auto id) {
+      emplace_back<id>(get<id>(v.current_storage()));
+    });
+  }
+
+  void push_back(variant<Types...>&& v)
+      requires(MoveConstructible<Types...>) {
+    if (v.valueless_by_exception()) {
+      throw bad_variant_access("push_back of valueless variant");
+    }
+    variant_impl::dispatch<void, sizeof...(Types)>(v.index(), [&](auto id) {
+      emplace_back<id>(std::move(get<id>(v.current_storage())));
+    });
+  }
+
+  /* Alternative is chosen as by the converting constructor of variant */
+  template <typename T,
+      typename T_j = decltype(variant_impl::converting_ctor_getter<T, Types...>::imaginary_func(std::declval<T&&>())),
+      std::size_t J = variant_impl::index_by_type<T_j, 0, Types...>::index>
+  requires(!std::is_same_v<std::remove_cvref_t<T>, variant<Types...>> && std::is_constructible_v<T_j, T>)
+  void push_back(T&& t) {
+    emplace_back<J>(std::forward<T>(t));
+  }
+
+  void pop_back() noexcept {
+    --length;
+    destroy(length);
+  }
+
+  void clear() noexcept {
+    if constexpr (!TriviallyDestructible<Types...>) {
+      for (std::size_t i = 0; i < length; ++i) {
+        destroy(i);
+      }
+    }
+    length = 0;
+  }
+
+  void swap(variant_vector& other) noexcept {
+    std::swap(tags, other.tags);
+    std::swap(payloads, other.payloads);
+    std::swap(length, other.length);
+    std::swap(reserved, other.reserved);
+  }
+
+
+  /* Calls vis with every element in order, dispatching on the tag array only */
+  template <typename Visitor>
+  void visit_each(Visitor&& vis) {
+    for (std::size_t i = 0; i < length; ++i) {
+      variant_impl::dispatch<void, sizeof...(Types)>(tags[i], [&](auto id) {
+        vis(variant_impl::unbox(alternative<id>(i)));
+      });
+    }
+  }
+
+  template <typename Visitor>
+  void visit_each(Visitor&& vis) const {
+    for (std::size_t i = 0; i < length; ++i) {
+      variant_impl::dispatch<void, sizeof...(Types)>(tags[i], [&](auto id) {
+        vis(variant_impl::unbox(alternative<id>(i)));
+      });
+    }
+  }
+
+private:
+  constexpr static std::size_t initial_capacity = 8;
+
+  void* slot(std::size_t pos) const noexcept {
+    return payloads + pos * slot_size;
+  }
+
+  template <std::size_t Id>
+  alternative_t<Id>& alternative(std::size_t pos) noexcept {
+    return *std::launder(static_cast<alternative_t<Id>*>(slot(pos)));
+  }
+
+  template <std::size_t Id>
+  alternative_t<Id> const& alternative(std::size_t pos) const noexcept {
+    return *std::launder(static_cast<alternative_t<Id> const*>(slot(pos)));
+  }
+
+  void destroy(std::size_t pos) noexcept {
+    if constexpr (!TriviallyDestructible<Types...>) {
+      variant_impl::dispatch<void, sizeof...(Types)>(tags[pos], [&](auto id) {
+        using T = alternative_t<id>;
+        alternative<id>(pos).~T();
+      });
+    }
+  }
+
+  void allocate(std::size_t count) {
+    payloads = static_cast<unsigned char*>(::operator new(count * slot_size, std::align_val_t(slot_align)));
+    try {
+      tags = new index_type[count];
+    } catch (...) {
+      ::operator delete(payloads, std::align_val_t(slot_align));
+      payloads = nullptr;
+      throw;
+    }
+    reserved = count;
+  }
+
+  void deallocate() noexcept {
+    delete[] tags;
+    if (payloads != nullptr) {
+      ::operator delete(payloads, std::align_val_t(slot_align));
+    }
+    tags = nullptr;
+    payloads = nullptr;
+    reserved = 0;
+  }
+
+  /* Moves elements to new storage of new_capacity slots, build constructs alternative Id at position length
+   * first, variant_npos means there is no new element */
+  template <std::size_t Id = variant_npos, typename Build>
+  void reallocate(std::size_t new_capacity, Build&& build) {
+    variant_vector fresh;
+    fresh.allocate(new_capacity);
+    build(fresh.slot(length));
+    if constexpr (Id != variant_npos) {
+      fresh.tags[length] = static_cast<index_type>(Id);
+    }
+    if (length != 0) {
+      std::memcpy(fresh.tags, tags, length * sizeof(index_type));
+      move_elements<Id>(fresh);
+    }
+    std::swap(tags, fresh.tags);
+    std::swap(payloads, fresh.payloads);
+    std::swap(reserved, fresh.reserved);
+  }
+
+  /* Elements are relocated if that can't throw, otherwise they are copied or moved as by std::move_if_noexcept
+   * and the old storage is left untouched on exception. Element being added to fresh is destroyed then too */
+  template <std::size_t Id>
+  void move_elements(variant_vector& fresh) {
+    if constexpr (TriviallyRelocatable<Types...>) {
+      std::memcpy(fresh.payloads, payloads, length * slot_size);
+    } else if constexpr (NothrowRelocatable<Types...>) {
+      for (std::size_t i = 0; i < length; ++i) {
+        variant_impl::dispatch<void, sizeof...(Types)>(tags[i], [&](auto id) {
+          relocate(&alternative<id>(i), static_cast<alternative_t<id>*>(fresh.slot(i)));
+        });
+      }
+    } else {
+      try {
+        for (; fresh.length < length; ++fresh.length) {
+          variant_impl::dispatch<void, sizeof...(Types)>(tags[fresh.length], [&](auto id) {
+            new (fresh.slot(fresh.length)) alternative_t<id>(std::move_if_noexcept(alternative<id>(fresh.length)));
+          });
+        }
+      } catch (...) {
+        if constexpr (Id != variant_npos) {
+          fresh.destroy(length);
+        }
+        fresh.clear();
+        throw;
+      }
+      fresh.length = 0;
+      for (std::size_t i = 0; i < length; ++i) {
+        destroy(i);
+      }
+    }
+  }
+
+  index_type* tags = nullptr;
+  unsigned char* payloads = nullptr;
+  std::size_t length = 0;
+  std::size_t reserved = 0;
+};
+
+
+template <typename... Types>
+void swap(variant_vector<Types...>& lhs, variant_vector<Types...>& rhs) noexcept {
+  lhs.swap(rhs);
+}
@@ -3,8 +3,11 @@
 #include "variant-helpers.h"
 #include "variant-type-traits.h"
 #include "variant-destructible-base.h"
+#include "variant-relocation.h"
+#include "variant-hash.h"
 
 #include <cassert>
+#include <compare>
 
 
 template <typename... Types>
@@ -15,6 +18,9 @@ private:
   using base = variant_impl::variant_destructible_base<Types...>;
   using T0 = typename variant_impl::alternative_by_index<0, Types...>::type;
 
+  static_assert(!variant_impl::NeverValueless<Types...> || !(variant_impl::is_boxed<Types> || ...),
+                "moving a box out leaves the variant valueless, so the never valueless policy can't hold boxes");
+
 public:
   constexpr variant() noexcept(NothrowConstructible<T0>)
       requires(DefaultConstructible<T0>)
@@ -27,16 +33,14 @@ public:
   constexpr variant(variant const& other)
       requires(CopyConstructible<Types...> && !TriviallyCopyConstructible<Types...>) {
     if (!other.valueless_by_exception()) {
-      variant_impl::internal_visit(
+      variant_impl::same_index_visit(
           []<typename A, typename B>(A& lhs, B&& rhs) {
-            if constexpr (std::is_same_v<A, std::remove_cvref_t<B>>) {
-              new (const_cast<std::remove_cvref_t<A>*>(std::addressof(lhs)))
-                  std::remove_cvref_t<A>(std::forward<B>(rhs));
-            }
+            new (const_cast<std::remove_cvref_t<A>*>(std::addressof(lhs)))
+                std::remove_cvref_t<A>(std::forward<B>(rhs));
           },
           *this, other);
     }
-    this->holding_index = other.index();
+    this->set_index(other.index());
   }
 
 
@@ -45,16 +49,15 @@ public:
   constexpr variant(variant&& other) noexcept(NothrowMoveConstructible<Types...>)
       requires(MoveConstructible<Types...> && !TriviallyMoveConstructible<Types...>) {
     if (!other.valueless_by_exception()) {
-      variant_impl::internal_visit(
+      variant_impl::same_index_visit(
           []<typename A, typename B>(A& lhs, B& rhs) {
-            if constexpr (std::is_same_v<A, std::remove_cvref_t<B>>) {
-              new (const_cast<std::remove_cvref_t<A>*>(std::addressof(lhs)))
-                  std::remove_cvref_t<A>(std::move(rhs));
-            }
+            new (const_cast<std::remove_cvref_t<A>*>(std::addressof(lhs)))
+                std::remove_cvref_t<A>(std::move(rhs));
           },
           *this, other);
     }
-    this->holding_index = other.index();
+    this->set_index(other.index());
+    release_moved_box(other);
   }
 
 
@@ -97,30 +100,17 @@ public:
       return *this;
     }
     if (index() == rhs.index()) {
-      variant_impl::internal_visit(
+      variant_impl::same_index_visit(
           []<typename A, typename B>(A& lhs, B& rhs) {
-            if constexpr (std::is_same_v<A, std::remove_cvref_t<B>>) {
-              lhs = rhs;
-            }
+            lhs = rhs;
           },
           *this, rhs);
       return *this;
     }
-    this->destroy();
-    try {
-      variant_impl::internal_visit(
-          []<typename A, typename B>(A& lhs, B&& rhs) {
-            if constexpr (std::is_same_v<A, std::remove_cvref_t<B>>) {
-              new (const_cast<std::remove_cvref_t<A>*>(std::addressof(lhs)))
-                  std::remove_cvref_t<A>(std::forward<B>(rhs));
-            }
-          },
-          *this, rhs);
-    } catch (...) {
-      this->holding_index = variant_npos;
-      throw;
-    }
-    this->holding_index = rhs.holding_index;
+    variant_impl::replace_alternative<NothrowCopyConstructible<Types...>>(
+        *this, rhs.index(), [&rhs](auto& storage) {
+          variant_impl::construct_from(storage, rhs.index(), rhs.current_storage());
+        });
     return *this;
   }
 
@@ -137,30 +127,19 @@ public:
       return *this;
     }
     if (index() == rhs.index()) {
-      variant_impl::internal_visit(
+      variant_impl::same_index_visit(
           []<typename A, typename B>(A& lhs, B& rhs) {
-            if constexpr (std::is_same_v<A, std::remove_cvref_t<B>>) {
-              lhs = std::move(rhs);
-            }
+            lhs = std::move(rhs);
           },
           *this, rhs);
+      release_moved_box(rhs);
       return *this;
     }
-    this->destroy();
-    try {
-      variant_impl::internal_visit(
-          []<typename A, typename B>(A& lhs, B& rhs) {
-            if constexpr (std::is_same_v<A, std::remove_cvref_t<B>>) {
-              new (const_cast<std::remove_cvref_t<A>*>(std::addressof(lhs)))
-                  std::remove_cvref_t<A>(std::move(rhs));
-            }
-          },
-          *this, rhs);
-    } catch (...) {
-      this->holding_index = variant_npos;
-      throw;
-    }
-    this->holding_index = rhs.holding_index;
+    variant_impl::replace_alternative<NothrowMoveConstructible<Types...>>(
+        *this, rhs.index(), [&rhs](auto& storage) {
+          variant_impl::construct_from(storage, rhs.index(), std::move(rhs.current_storage()));
+        });
+    release_moved_box(rhs);
     return *this;
   }
 
@@ -172,55 +151,53 @@ public:
       requires(!std::is_same_v<std::remove_cvref_t<T>, variant<Types...>> &&
           std::is_assignable_v<T_j&, T> &&
           std::is_constructible_v<T_j, T>) {
-    if (holds_alternative<T_j>(*this)) {
-      get<J>(*this) = std::forward<T>(t);
-      this->holding_index = J;
-      return *this;
-    }
-    if (std::is_nothrow_constructible_v<T_j, T> || !std::is_nothrow_move_constructible_v<T_j>) {
+    if (this->current_index() == J) {
+      get<J>(this->current_storage()) = std::forward<T>(t);
+    } else if constexpr (std::is_nothrow_constructible_v<T_j, T> || !std::is_nothrow_move_constructible_v<T_j>) {
       this->emplace<J>(std::forward<T>(t));
-      this->holding_index = J;
-      return *this;
+    } else {
+      this->emplace<J>(T_j(std::forward<T>(t)));
     }
-    this->emplace<J>(T_j(std::forward<T>(t)));
-    this->holding_index = J;
     return *this;
   }
 
 
   constexpr std::size_t index() const noexcept {
-    return this->holding_index;
+    return this->current_index();
   }
 
   constexpr bool valueless_by_exception() const noexcept {
-    return this->holding_index == variant_npos;
+    if constexpr (variant_impl::NeverValueless<Types...>) {
+      return false;
+    } else {
+      return this->current_index() == variant_npos;
+    }
   }
 
   template <typename T, typename... Args>
   requires(UniqueEntry<T, Types...> && ConstructibleFrom<T, Args...>)
-  constexpr T& emplace(Args&&... args) {
+  constexpr variant_impl::unboxed_t<T>& emplace(Args&&... args) {
     return emplace<variant_impl::index_by_type<T, 0, Types...>::index>(std::forward<Args>(args)...);
   }
 
   template <std::size_t Id, typename... Args>
   requires(InBound<Id, Types...> && ConstructibleFrom<typename variant_impl::alternative_by_index<Id, Types...>::type, Args...>)
   constexpr variant_alternative_t<Id, variant>& emplace(Args&&... args) {
-    this->destroy();
-    try {
-      this->holding_index = Id;
-      variant_impl::internal_visit(
-          [&]<typename T>(T& alt) {
-            if constexpr (std::is_constructible_v<std::remove_cvref_t<T>, Args...>) {
-              new (const_cast<std::remove_cvref_t<T>*>(std::addressof(alt)))
-                  std::remove_cvref_t<T>(std::forward<Args>(args)...);
-            }
-          },
-          *this);
-      return get<Id>(this->storage);
-    } catch (...) {
-      this->holding_index = variant_npos;
-      throw;
+    constexpr bool nothrow =
+        std::is_nothrow_constructible_v<typename variant_impl::alternative_by_index<Id, Types...>::type, Args...>;
+    auto build = [&](auto& storage) {
+      variant_impl::construct<Id>(storage, std::forward<Args>(args)...);
+    };
+    /* New alternative is constructed at its static index, the old one is destroyed
+     * without a dispatch if it is known to be the same alternative */
+    if constexpr (TriviallyDestructible<Types...>) {
+      variant_impl::replace_alternative<nothrow>(*this, Id, build);
+    } else if (this->current_index() == Id) {
+      variant_impl::replace_alternative<nothrow, Id>(*this, Id, build);
+    } else {
+      variant_impl::replace_alternative<nothrow>(*this, Id, build);
     }
+    return variant_impl::unbox(get<Id>(this->current_storage()));
   }
 
   constexpr void swap(variant& rhs)
@@ -229,12 +206,10 @@ public:
       return;
     }
     if (index() == rhs.index()) {
-      variant_impl::internal_visit(
+      variant_impl::same_index_visit(
           []<typename A, typename B>(A& lhs, B& rhs) {
-            if constexpr (std::is_same_v<A, B>) {
-              using std::swap;
-              swap(lhs, rhs);
-            }
+            using std::swap;
+            swap(lhs, rhs);
           },
           *this, rhs);
       return;
@@ -249,9 +224,68 @@ public:
       this->destroy();
       return;
     }
-    auto tmp(std::move(*this));
-    *this = std::move(rhs);
-    rhs = std::move(tmp);
+    if (std::is_constant_evaluated()) {
+      auto tmp(std::move(*this));
+      *this = std::move(rhs);
+      rhs = std::move(tmp);
+      return;
+    }
+    swap_different_alternatives(rhs);
+  }
+
+private:
+  friend struct variant_impl::valueless_construct_t;
+
+  /* Valueless even under the never valueless policy, the caller must construct an alternative or destroy it */
+  constexpr explicit variant(variant_impl::valueless_construct_t) noexcept
+      : base()
+  {}
+
+  /* A box moved out owns nothing: the variant holding it becomes valueless, so visit, get and comparisons
+   * see a valueless variant instead of dereferencing null. Variants without boxes skip the check */
+  static constexpr void release_moved_box(variant& moved) noexcept {
+    if constexpr ((variant_impl::is_boxed<Types> || ...)) {
+      if (moved.valueless_by_exception()) {
+        return;
+      }
+      bool released = variant_impl::dispatch<bool, sizeof...(Types)>(moved.index(), [&](auto id) {
+        auto& alt = get<id>(moved.current_storage());
+        if constexpr (variant_impl::is_boxed<std::remove_cvref_t<decltype(alt)>>) {
+          return alt.valueless_after_move();
+        } else {
+          return false;
+        }
+      });
+      if (released) {
+        moved.destroy();
+      }
+    }
+  }
+
+  /* One dispatch over both indexes: a pair of relocatable alternatives is exchanged byte-wise,
+   * otherwise rhs alternative is moved aside and both alternatives are moved directly to their new places */
+  void swap_different_alternatives(variant& rhs) {
+    if constexpr (TriviallyRelocatable<Types...>) {
+      variant_impl::swap_bytes(*this, rhs);
+    } else {
+      variant_impl::dispatch<void, sizeof...(Types)>(rhs.index(), [&](auto j) {
+        auto& b = get<j>(rhs.current_storage());
+        using B = std::remove_cvref_t<decltype(b)>;
+        variant_impl::dispatch<void, sizeof...(Types)>(index(), [&](auto i) {
+          auto& a = get<i>(this->current_storage());
+          using A = std::remove_cvref_t<decltype(a)>;
+          if constexpr (TriviallyRelocatable<A, B>) {
+            variant_impl::swap_bytes(*this, rhs);
+          } else {
+            B tmp(std::move(b));
+            variant_impl::replace_alternative<std::is_nothrow_move_constructible_v<A>, j>(
+                rhs, i, [&](auto& storage) { variant_impl::construct<i>(storage, std::move(a)); });
+            variant_impl::replace_alternative<std::is_nothrow_move_constructible_v<B>, i>(
+                *this, j, [&](auto& storage) { variant_impl::construct<j>(storage, std::move(tmp)); });
+          }
+        });
+      });
+    }
   }
 };
 
@@ -277,6 +311,24 @@ constexpr R visit(Visitor&& vis, Variants&&... vars)
 }
 
 
+/* Same as visit, but no variant may be valueless. It is checked by assert only,
+ * so in release builds the visitor is dispatched directly on the indexes */
+template <typename Visitor, typename... Variants>
+constexpr decltype(auto) visit_unchecked(Visitor&& vis, Variants&&... vars)
+    requires(variant_impl::is_variant_specialization<std::remove_cvref_t<Variants>>::value && ...) {
+  using R = decltype(std::forward<Visitor>(vis)(get_unchecked<0>(std::forward<Variants>(vars))...));
+  return visit_unchecked<R>(std::forward<Visitor>(vis), std::forward<Variants>(vars)...);
+}
+
+template <typename R, typename Visitor, typename... Variants>
+constexpr R visit_unchecked(Visitor&& vis, Variants&&... vars)
+    requires(variant_impl::is_variant_specialization<std::remove_cvref_t<Variants>>::value && ...) {
+  assert(!(vars.valueless_by_exception() || ...) && "visit_unchecked on valueless variant");
+  return variant_impl::invoker<R, Visitor, Variants...>
+      ::invoke(std::forward<Visitor>(vis), std::forward<Variants>(vars)...);
+}
+
+
 template <typename T, typename... Types>
 constexpr bool holds_alternative(variant<Types...> const& v) noexcept {
   return v.index() == variant_impl::index_by_type<T, 0, Types...>::index;
@@ -286,7 +338,7 @@ constexpr bool holds_alternative(variant<Types...> const& v) noexcept {
 template <std::size_t Id, typename... Types>
 constexpr variant_alternative_t<Id, variant<Types...>>& get(variant<Types...>& v) {
   if (v.index() == Id) {
-    return get<Id>(v.storage);
+    return variant_impl::unbox(get<Id>(v.current_storage()));
   }
   throw bad_variant_access("accessing non-holding alternative");
 }
@@ -294,7 +346,7 @@ constexpr variant_alternative_t<Id, variant<Types...>>& get(variant<Types...>& v
 template <std::size_t Id, typename... Types>
 constexpr variant_alternative_t<Id, variant<Types...>>&& get(variant<Types...>&& v) {
   if (v.index() == Id) {
-    return std::move(get<Id>(std::move(v.storage)));
+    return std::move(variant_impl::unbox(get<Id>(std::move(v.current_storage()))));
   }
   throw bad_variant_access("accessing non-holding alternative");
 }
@@ -302,7 +354,7 @@ constexpr variant_alternative_t<Id, variant<Types...>>&& get(variant<Types...>&&
 template <std::size_t Id, typename... Types>
 constexpr const variant_alternative_t<Id, variant<Types...>>& get(const variant<Types...>& v) {
   if (v.index() == Id) {
-    return get<Id>(v.storage);
+    return variant_impl::unbox(get<Id>(v.current_storage()));
   }
   throw bad_variant_access("accessing non-holding alternative");
 }
@@ -310,14 +362,14 @@ constexpr const variant_alternative_t<Id, variant<Types...>>& get(const variant<
 template <std::size_t Id, typename... Types>
 constexpr const variant_alternative_t<Id, variant<Types...>>&& get(const variant<Types...>&& v) {
   if (v.index() == Id) {
-    return std::move(get<Id>(std::move(v.storage)));
+    return std::move(variant_impl::unbox(get<Id>(std::move(v.current_storage()))));
   }
   throw bad_variant_access("accessing non-holding alternative");
 }
 
 
 template <typename T, typename... Types>
-constexpr T& get(variant<Types...>& v) {
+constexpr variant_impl::unboxed_t<T>& get(variant<Types...>& v) {
   if (holds_alternative<T>(v)) {
     return get<variant_impl::index_by_type<T, 0, Types...>::index>(v);
   }
@@ -325,7 +377,7 @@ constexpr T& get(variant<Types...>& v) {
 }
 
 template <typename T, typename... Types>
-constexpr T&& get(variant<Types...>&& v) {
+constexpr variant_impl::unboxed_t<T>&& get(variant<Types...>&& v) {
   if (holds_alternative<T>(v)) {
     return std::move(get<variant_impl::index_by_type<T, 0, Types...>::index>(std::move(v)));
   }
@@ -334,7 +386,7 @@ constexpr T&& get(variant<Types...>&& v) {
 
 
 template <typename T, typename... Types>
-constexpr const T& get(const variant<Types...>& v) {
+constexpr const variant_impl::unboxed_t<T>& get(const variant<Types...>& v) {
   if (holds_alternative<T>(v)) {
     return get<variant_impl::index_by_type<T, 0, Types...>::index>(v);
   }
@@ -342,7 +394,7 @@ constexpr const T& get(const variant<Types...>& v) {
 }
 
 template <typename T, typename... Types>
-constexpr const T&& get( const std::variant<Types...>&& v ) {
+constexpr const variant_impl::unboxed_t<T>&& get(const variant<Types...>&& v) {
   if (holds_alternative<T>(v)) {
     return std::move(get<variant_impl::index_by_type<T, 0, Types...>::index>(std::move(v)));
   }
@@ -350,11 +402,60 @@ constexpr const T&& get( const std::variant<Types...>&& v ) {
 }
 
 
+/* Unchecked access for code that already knows the index, e.g. after a switch on index().
+ * Precondition: v holds the requested alternative. It is checked by assert only,
+ * so in release builds access is a plain load from the storage */
+template <std::size_t Id, typename... Types>
+constexpr variant_alternative_t<Id, variant<Types...>>& get_unchecked(variant<Types...>& v) noexcept {
+  assert(v.index() == Id && "get_unchecked of non-holding alternative");
+  return variant_impl::unbox(get<Id>(v.current_storage()));
+}
+
+template <std::size_t Id, typename... Types>
+constexpr variant_alternative_t<Id, variant<Types...>>&& get_unchecked(variant<Types...>&& v) noexcept {
+  assert(v.index() == Id && "get_unchecked of non-holding alternative");
+  return std::move(variant_impl::unbox(get<Id>(std::move(v.current_storage()))));
+}
+
+template <std::size_t Id, typename... Types>
+constexpr const variant_alternative_t<Id, variant<Types...>>& get_unchecked(const variant<Types...>& v) noexcept {
+  assert(v.index() == Id && "get_unchecked of non-holding alternative");
+  return variant_impl::unbox(get<Id>(v.current_storage()));
+}
+
+template <std::size_t Id, typename... Types>
+constexpr const variant_alternative_t<Id, variant<Types...>>&& get_unchecked(const variant<Types...>&& v) noexcept {
+  assert(v.index() == Id && "get_unchecked of non-holding alternative");
+  return std::move(variant_impl::unbox(get<Id>(std::move(v.current_storage()))));
+}
+
+
+template <typename T, typename... Types>
+constexpr variant_impl::unboxed_t<T>& get_unchecked(variant<Types...>& v) noexcept {
+  return get_unchecked<variant_impl::index_by_type<T, 0, Types...>::index>(v);
+}
+
+template <typename T, typename... Types>
+constexpr variant_impl::unboxed_t<T>&& get_unchecked(variant<Types...>&& v) noexcept {
+  return get_unchecked<variant_impl::index_by_type<T, 0, Types...>::index>(std::move(v));
+}
+
+template <typename T, typename... Types>
+constexpr const variant_impl::unboxed_t<T>& get_unchecked(const variant<Types...>& v) noexcept {
+  return get_unchecked<variant_impl::index_by_type<T, 0, Types...>::index>(v);
+}
+
+template <typename T, typename... Types>
+constexpr const variant_impl::unboxed_t<T>&& get_unchecked(const variant<Types...>&& v) noexcept {
+  return get_unchecked<variant_impl::index_by_type<T, 0, Types...>::index>(std::move(v));
+}
+
+
 template <std::size_t Id, typename... Types>
 constexpr std::add_pointer_t<variant_alternative_t<Id, variant<Types...>>>
 get_if(variant<Types...>* pv) noexcept {
   if (pv != nullptr && pv->index() == Id) {
-    return std::addressof(get<Id>(pv->storage));
+    return std::addressof(variant_impl::unbox(get<Id>(pv->current_storage())));
   }
   return nullptr;
 }
@@ -363,37 +464,34 @@ template <std::size_t Id, typename... Types>
 constexpr std::add_pointer_t<const variant_alternative_t<Id, variant<Types...>>>
 get_if(const variant<Types...>* pv) noexcept {
   if (pv != nullptr && pv->index() == Id) {
-    return std::addressof(get<Id>(pv->storage));
+    return std::addressof(variant_impl::unbox(get<Id>(pv->current_storage())));
   }
   return nullptr;
 }
 
 
 template <typename T, typename... Types>
-constexpr std::add_pointer_t<T> get_if(variant<Types...>* pv) noexcept {
+constexpr std::add_pointer_t<variant_impl::unboxed_t<T>> get_if(variant<Types...>* pv) noexcept {
   return get_if<variant_impl::index_by_type<T, 0, Types...>::index>(pv);
 }
 
 template <typename T, typename... Types>
-constexpr std::add_pointer_t<const T> get_if(const variant<Types...>* pv) noexcept {
+constexpr std::add_pointer_t<const variant_impl::unboxed_t<T>> get_if(const variant<Types...>* pv) noexcept {
   return get_if<variant_impl::index_by_type<T, 0, Types...>::index>(pv);
 }
 
 
+/* Alternatives are compared by a single dispatch on the common index, indexes are shifted by one
+ * so that valueless variants are ordered first without separate checks */
 template <typename... Types>
 constexpr bool operator==(const variant<Types...>& v, const variant<Types...>& w) {
-  if (v.index() != w.index()) {
-    return false;
+  std::size_t i = variant_impl::ordering_index(v);
+  std::size_t j = variant_impl::ordering_index(w);
+  if (i != j || i == 0) {
+    return i == j;
   }
-  if (v.valueless_by_exception()) {
-    return true;
-  }
-  return visit([]<typename A, typename B>(A const& lhs, B const& rhs) -> bool {
-    if constexpr (std::is_same_v<A, B>) {
-      return lhs == rhs;
-    } else {
-      return false;
-    }
+  return variant_impl::same_index_visit<bool>([](auto const& lhs, auto const& rhs) -> bool {
+    return variant_impl::unbox(lhs) == variant_impl::unbox(rhs);
   }, v, w);
 }
 
@@ -404,101 +502,111 @@ constexpr bool operator!=(const variant<Types...>& v, const variant<Types...>& w
 
 template <typename... Types>
 constexpr bool operator<(const variant<Types...>& v, const variant<Types...>& w) {
-  if (w.valueless_by_exception()) {
-    return false;
-  }
-  if (v.valueless_by_exception()) {
-    return true;
-  }
-  if (v.index() < w.index()) {
-    return true;
-  }
-  if (v.index() > w.index()) {
-    return false;
+  std::size_t i = variant_impl::ordering_index(v);
+  std::size_t j = variant_impl::ordering_index(w);
+  if (i != j || i == 0) {
+    return i < j;
   }
-
-  return visit([]<typename A, typename B>(A const& lhs, B const& rhs) -> bool {
-    if constexpr (std::is_same_v<A, B>) {
-      return lhs < rhs;
-    } else {
-      return false;
-    }
+  return variant_impl::same_index_visit<bool>([](auto const& lhs, auto const& rhs) -> bool {
+    return variant_impl::unbox(lhs) < variant_impl::unbox(rhs);
   }, v, w);
 }
 
 template <typename... Types>
 constexpr bool operator>(const variant<Types...>& v, const variant<Types...>& w) {
-  if (v.valueless_by_exception()) {
-    return false;
+  std::size_t i = variant_impl::ordering_index(v);
+  std::size_t j = variant_impl::ordering_index(w);
+  if (i != j || i == 0) {
+    return i > j;
   }
-  if (w.valueless_by_exception()) {
-    return true;
-  }
-  if (v.index() > w.index()) {
-    return true;
-  }
-  if (v.index() < w.index()) {
-    return false;
-  }
-
-  return visit([]<typename A, typename B>(A const& lhs, B const& rhs) -> bool {
-    if constexpr (std::is_same_v<A, B>) {
-      return lhs > rhs;
-    } else {
-      return false;
-    }
+  return variant_impl::same_index_visit<bool>([](auto const& lhs, auto const& rhs) -> bool {
+    return variant_impl::unbox(lhs) > variant_impl::unbox(rhs);
   }, v, w);
 }
 
 template <typename... Types>
 constexpr bool operator<=(const variant<Types...>& v, const variant<Types...>& w) {
-  if (v.valueless_by_exception()) {
-    return true;
+  std::size_t i = variant_impl::ordering_index(v);
+  std::size_t j = variant_impl::ordering_index(w);
+  if (i != j || i == 0) {
+    return i <= j;
   }
-  if (w.valueless_by_exception()) {
-    return false;
-  }
-  if (v.index() < w.index()) {
-    return true;
-  }
-  if (v.index() > w.index()) {
-    return false;
-  }
-
-  return visit([]<typename A, typename B>(A const& lhs, B const& rhs) -> bool {
-    if constexpr (std::is_same_v<A, B>) {
-      return lhs <= rhs;
-    } else {
-      return false;
-    }
+  return variant_impl::same_index_visit<bool>([](auto const& lhs, auto const& rhs) -> bool {
+    return variant_impl::unbox(lhs) <= variant_impl::unbox(rhs);
   }, v, w);
 }
 
 template <typename... Types>
 constexpr bool operator>=(const variant<Types...>& v, const variant<Types...>& w) {
-  if (w.valueless_by_exception()) {
-    return true;
-  }
-  if (v.valueless_by_exception()) {
-    return false;
-  }
-  if (v.index() > w.index()) {
-    return true;
-  }
-  if (v.index() < w.index()) {
-    return false;
+  std::size_t i = variant_impl::ordering_index(v);
+  std::size_t j = variant_impl::ordering_index(w);
+  if (i != j || i == 0) {
+    return i >= j;
   }
+  return variant_impl::same_index_visit<bool>([](auto const& lhs, auto const& rhs) -> bool {
+    return variant_impl::unbox(lhs) >= variant_impl::unbox(rhs);
+  }, v, w);
+}
 
-  return visit([]<typename A, typename B>(A const& lhs, B const& rhs) -> bool {
-    if constexpr (std::is_same_v<A, B>) {
-      return lhs >= rhs;
-    } else {
-      return false;
-    }
+template <typename... Types>
+constexpr std::common_comparison_category_t<std::compare_three_way_result_t<variant_impl::unboxed_t<Types>>...>
+operator<=>(const variant<Types...>& v, const variant<Types...>& w)
+    requires(std::three_way_comparable<variant_impl::unboxed_t<Types>> && ...) {
+  using result_t = std::common_comparison_category_t<std::compare_three_way_result_t<variant_impl::unboxed_t<Types>>...>;
+  std::size_t i = variant_impl::ordering_index(v);
+  std::size_t j = variant_impl::ordering_index(w);
+  if (i != j || i == 0) {
+    return i <=> j;
+  }
+  return variant_impl::same_index_visit<result_t>([](auto const& lhs, auto const& rhs) -> result_t {
+    return variant_impl::unbox(lhs) <=> variant_impl::unbox(rhs);
   }, v, w);
 }
 
 
+/* Comparisons with a value of an alternative order it as a variant holding that alternative would be,
+ * no temporary variant is constructed. Reversed operands of == and <=> are provided by the language */
+template <typename T, typename... Types>
+constexpr bool operator==(const variant<Types...>& v, const T& t)
+    requires(UniqueEntry<T, Types...>) {
+  constexpr std::size_t Id = variant_impl::index_by_type<T, 0, Types...>::index;
+  return v.index() == Id && variant_impl::unbox(get<Id>(v.current_storage())) == t;
+}
+
+template <typename T, typename... Types>
+constexpr bool operator<(const variant<Types...>& v, const T& t)
+    requires(UniqueEntry<T, Types...>) {
+  constexpr std::size_t Id = variant_impl::index_by_type<T, 0, Types...>::index;
+  std::size_t i = variant_impl::ordering_index(v);
+  if (i != Id + 1) {
+    return i < Id + 1;
+  }
+  return variant_impl::unbox(get<Id>(v.current_storage())) < t;
+}
+
+template <typename T, typename... Types>
+constexpr bool operator<(const T& t, const variant<Types...>& v)
+    requires(UniqueEntry<T, Types...>) {
+  constexpr std::size_t Id = variant_impl::index_by_type<T, 0, Types...>::index;
+  std::size_t i = variant_impl::ordering_index(v);
+  if (i != Id + 1) {
+    return Id + 1 < i;
+  }
+  return t < variant_impl::unbox(get<Id>(v.current_storage()));
+}
+
+template <typename T, typename... Types>
+constexpr std::compare_three_way_result_t<T> operator<=>(const variant<Types...>& v, const T& t)
+    requires(UniqueEntry<T, Types...> && std::three_way_comparable<T>) {
+  constexpr std::size_t Id = variant_impl::index_by_type<T, 0, Types...>::index;
+  std::size_t i = variant_impl::ordering_index(v);
+  if (i != Id + 1) {
+    return i <=> Id + 1;
+  }
+  return variant_impl::unbox(get<Id>(v.current_storage())) <=> t;
+}
+
+
 template <typename... Types>
 constexpr void swap(variant<Types...>& lhs, variant<Types...>& rhs) noexcept(noexcept(lhs.swap(rhs)))
     requires(MoveConstructible<Types...> && Swappable<Types...>) {